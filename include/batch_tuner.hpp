@@ -0,0 +1,95 @@
+#ifndef BATCH_TUNER_HPP
+#define BATCH_TUNER_HPP
+
+#include <deque>
+#include <string>
+#include <cstddef>
+#include <unordered_map>
+
+#include "tick_time.hpp"
+
+/// Searches online for the batch size of each inbound path and the credit
+/// cycle duration of a sink that maximize throughput while keeping the
+/// latency of batches below a target. Latency is the time from the arrival of
+/// a batch in the mailbox until the sink finished processing it.
+///
+/// Each cycle, the tuner hill-climbs the batch size of each path: it keeps
+/// growing (or shrinking) the batch size by 25% as long as the throughput of
+/// the path does not drop and reverses direction otherwise. A single batch
+/// never takes longer than half the target to process, based on a smoothed
+/// processing time per item. Whenever a path misses the target, the tuner
+/// halves its batch size. The cycle duration shrinks when any path misses
+/// the target and grows while all paths stay well below it.
+class batch_tuner {
+public:
+  /// Maximum number of decisions in the log.
+  static constexpr size_t max_decisions = 8;
+
+  /// @param target Latency target in ticks.
+  /// @param min_batch_size Lower bound for all batch sizes.
+  /// @param cycle_duration Initial credit cycle duration.
+  batch_tuner(tick_duration target, long min_batch_size,
+              tick_duration cycle_duration);
+
+  /// Starts tuning the batch size of `key` with `name` in the log.
+  void add_path(const void* key, std::string name, long batch_size);
+
+  /// Stops tuning the batch size of `key`.
+  void remove_path(const void* key);
+
+  /// Records a batch with `xs_size` items of `key`.
+  void record(const void* key, long xs_size, tick_duration latency,
+              tick_duration processing_time);
+
+  /// Adjusts all batch sizes and the cycle duration after a cycle of length
+  /// `duration` that ended at `now`.
+  void end_cycle(tick_time now, tick_duration duration);
+
+  /// Returns the batch size for `key` or 0 if `key` is unknown.
+  long batch_size(const void* key) const;
+
+  /// Returns the credit cycle duration.
+  inline tick_duration cycle_duration() const {
+    return cycle_duration_;
+  }
+
+  /// Returns the latency target.
+  inline tick_duration target() const {
+    return target_;
+  }
+
+  /// Returns the most recent decisions, oldest first.
+  inline const std::deque<std::string>& decisions() const {
+    return decisions_;
+  }
+
+private:
+  struct path_state {
+    std::string name;
+    long batch_size;
+    /// Smoothed processing time per item or 0 if unknown.
+    double time_per_item;
+    /// Throughput of the previous cycle in items per tick.
+    double last_throughput;
+    /// Either 1 for growing or -1 for shrinking the batch size.
+    int direction;
+    /// Measurements of the current cycle.
+    long items;
+    tick_duration processing_time;
+    tick_duration max_latency;
+  };
+
+  /// Adjusts the batch size of `x` and returns the largest latency of `x`.
+  tick_duration tune(path_state& x, tick_time now, tick_duration duration);
+
+  /// Adds an entry to the log.
+  void log(tick_time now, std::string what);
+
+  tick_duration target_;
+  long min_batch_size_;
+  tick_duration cycle_duration_;
+  std::unordered_map<const void*, path_state> paths_;
+  std::deque<std::string> decisions_;
+};
+
+#endif // BATCH_TUNER_HPP
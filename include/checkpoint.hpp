@@ -0,0 +1,111 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <type_traits>
+
+#include "tick_time.hpp"
+
+/// Serializes state into a compact byte sequence. Integers are zigzag and
+/// varint encoded, i.e., most values occupy a single byte.
+class state_writer {
+public:
+  template <class T>
+  std::enable_if_t<std::is_integral<T>::value> put(T x) {
+    put_int(static_cast<int64_t>(x));
+  }
+
+  void put(double x);
+
+  void put(const std::string& x);
+
+  inline const std::vector<uint8_t>& bytes() const {
+    return buf_;
+  }
+
+  inline std::vector<uint8_t> take() {
+    return std::move(buf_);
+  }
+
+private:
+  void put_int(int64_t x);
+
+  std::vector<uint8_t> buf_;
+};
+
+/// Reads values written by a `state_writer` in the same order.
+class state_reader {
+public:
+  explicit state_reader(const std::vector<uint8_t>& buf);
+
+  /// Reads the next integer into `x`.
+  /// @returns `false` if the buffer has no more integers, `true` otherwise.
+  template <class T>
+  std::enable_if_t<std::is_integral<T>::value, bool> get(T& x) {
+    int64_t tmp;
+    if (!get_int(tmp))
+      return false;
+    x = static_cast<T>(tmp);
+    return true;
+  }
+
+private:
+  bool get_int(int64_t& x);
+
+  const std::vector<uint8_t>& buf_;
+
+  size_t pos_;
+};
+
+/// Captures the state of a simulation at a given tick.
+///
+/// Simulants keep suspended fibers as well as CAF stream state, and tick
+/// events are arbitrary function objects. None of this can be written to a
+/// file and read back. Hence, a checkpoint stores everything needed to
+/// reproduce a run deterministically up to `time` (seed, layout and delay
+/// bounds) plus a serialized snapshot of all state. Verifying a checkpoint
+/// applies the stored entity parameters to a fresh simulation, fast-forwards
+/// it to `time` without rendering anything and then compares its state to the
+/// snapshot section by section.
+class checkpoint {
+public:
+  /// A named part of the snapshot, e.g., the environment or an entity.
+  using section = std::pair<std::string, std::vector<uint8_t>>;
+
+  /// Seed for the random number generator.
+  uint32_t seed = 0;
+
+  /// Topology of the simulation.
+  std::string layout;
+
+  /// Simulation time of the snapshot.
+  tick_time time = 0;
+
+  /// Bounds for message delays.
+  tick_duration min_delay = 1;
+  tick_duration max_delay = 1;
+
+  /// Serialized state of the simulation.
+  std::vector<section> sections;
+
+  /// Writes this checkpoint to `path`.
+  /// @returns `false` if the file cannot be written, `true` otherwise.
+  bool save(const std::string& path) const;
+
+  /// Reads a checkpoint from `path`.
+  /// @returns `false` if the file is not a valid checkpoint, `true` otherwise.
+  bool load(const std::string& path);
+
+  /// Returns the name of the first section that differs between this
+  /// checkpoint and `other` or an empty string if both snapshots are equal.
+  std::string first_difference(const checkpoint& other) const;
+
+  /// Returns the section with given name or `nullptr` if no such section
+  /// exists.
+  const std::vector<uint8_t>* find(const std::string& name) const;
+};
+
+#endif // CHECKPOINT_HPP
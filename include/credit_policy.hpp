@@ -0,0 +1,84 @@
+#ifndef CREDIT_POLICY_HPP
+#define CREDIT_POLICY_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "fwd.hpp"
+#include "tick_time.hpp"
+
+/// Observations of a sink during a single credit cycle.
+struct credit_cycle {
+  /// Length of the cycle.
+  tick_duration duration = 0;
+
+  /// Number of processed items.
+  long processed_items = 0;
+
+  /// Number of completed batches.
+  long batches = 0;
+
+  /// Time batches waited in the mailbox before processing started.
+  tick_duration queueing_time = 0;
+
+  /// Average processing time per item or 0 if the sink processed nothing.
+  double time_per_item = 0;
+
+  /// Number of items the sink could process if it worked during an entire
+  /// cycle or 0 if the sink processed nothing.
+  double capacity = 0;
+};
+
+/// Tuning parameters for all credit policies.
+struct credit_policy_params {
+  /// Minimum number of tokens per cycle. The static policy always grants
+  /// this many tokens.
+  double min_tokens = 100;
+
+  /// Desired average time a batch waits in the mailbox.
+  tick_duration target_delay = 20;
+
+  /// Gains of the PID policy.
+  double proportional = 1;
+  double integral = .2;
+  double derivative = 0;
+
+  /// Tokens the AIMD policy adds per cycle without congestion.
+  double increase = 5;
+
+  /// Factor the AIMD policy multiplies its window with on congestion.
+  double decrease = .5;
+};
+
+/// Computes how many tokens a sink grants its sources per credit cycle.
+class credit_policy {
+public:
+  virtual ~credit_policy();
+
+  /// Returns the name for selecting this policy.
+  virtual const char* name() const = 0;
+
+  /// Returns the number of tokens for the next cycle.
+  virtual long generate_tokens(const credit_cycle& x) = 0;
+
+  /// Serializes the controller state to `out`.
+  virtual void save_state(state_writer& out) const = 0;
+};
+
+using credit_policy_ptr = std::unique_ptr<credit_policy>;
+
+/// Returns the names of all available policies:
+/// - `cycle` grants what the sink processed at full utilization during the
+///   last cycle
+/// - `pid` corrects the capacity with a PID controller on the queueing delay
+/// - `aimd` grows its window additively until batches queue up and shrinks it
+///   multiplicatively afterwards, like TCP congestion control
+/// - `static` always grants `min_tokens`
+const std::vector<std::string>& credit_policy_names();
+
+/// Returns a new policy by name or `nullptr` if `name` is unknown.
+credit_policy_ptr make_credit_policy(const std::string& name,
+                                     const credit_policy_params& params);
+
+#endif // CREDIT_POLICY_HPP
@@ -1,9 +1,14 @@
 #ifndef GRAPH_WIDGET_HPP
 #define GRAPH_WIDGET_HPP
 
+#include <vector>
+
+#include <QLineF>
+#include <QVector>
 #include <QGraphicsView>
 
 #include "fwd.hpp"
+#include "quadtree.hpp"
 
 /// Models a widget for displaying directed acyclic graphs (DAGs).
 class dag_widget : public QGraphicsView {
@@ -12,10 +17,30 @@ class dag_widget : public QGraphicsView {
 public:
   using super = QGraphicsView;
 
+  /// Selects how `arrange` places nodes.
+  enum layout_mode {
+    /// Ranks nodes by pipeline depth and places them in columns.
+    layered,
+    /// Places nodes randomly and relaxes springs between them.
+    force_directed
+  };
+
+  /// Nodes and edges drop details such as text, shadows and arrow heads at
+  /// scales below this level of detail.
+  static constexpr qreal min_detail = 0.5;
+
   dag_widget(QWidget* parent = 0);
 
   void itemMoved();
 
+  inline layout_mode mode() const {
+    return mode_;
+  }
+
+  inline void mode(layout_mode x) {
+    mode_ = x;
+  }
+
   inline node* selected() {
     return selected_;
   }
@@ -23,6 +48,13 @@ public:
   void selected(node* x);
 
 public slots:
+  /// Places all nodes according to the layout mode.
+  void arrange();
+
+  /// Places all nodes in columns by pipeline depth and orders each column to
+  /// reduce edge crossings.
+  void layer();
+
   void shuffle();
   void zoomIn();
   void zoomOut();
@@ -32,14 +64,36 @@ protected:
   void keyPressEvent(QKeyEvent* event) override;
   void timerEvent(QTimerEvent* event) override;
 
+  /// Draws all edges as a single batch of lines when zoomed out.
+  void drawForeground(QPainter* painter, const QRectF& rect) override;
+
   void scaleView(qreal scaleFactor);
 
 private:
   void centerize_dag();
 
+  /// Returns all nodes in the scene.
+  std::vector<node*> nodes();
+
+  /// Moves all nodes one step along their forces and stores the sum of their
+  /// squared moves in `energy`.
+  /// @returns whether any node moved.
+  bool relax(const std::vector<node*>& xs, qreal& energy);
+
   int timerId;
   node* centernode;
   node* selected_;
+
+  layout_mode mode_;
+
+  /// Approximates the repulsion between nodes.
+  quadtree repulsion_;
+
+  /// Stores node positions for building `repulsion_`.
+  std::vector<QPointF> positions_;
+
+  /// Stores edges for batch drawing in `drawForeground`.
+  QVector<QLineF> lines_;
 };
 
 #endif // GRAPH_WIDGET_HPP
@@ -1,6 +1,7 @@
 #ifndef EDGE_HPP
 #define EDGE_HPP
 
+#include <QPolygonF>
 #include <QGraphicsItem>
 
 #include "fwd.hpp"
@@ -17,8 +18,14 @@ public:
     return dest_;
   }
 
+  /// Recomputes the end points and the arrow head after moving a node.
   void adjust();
 
+  /// Returns the visible part of the edge in scene coordinates.
+  inline QLineF line() const {
+    return {source_point_, dest_point_};
+  }
+
   enum { Type = UserType + 2 };
 
   int type() const override;
@@ -35,6 +42,7 @@ private:
   QPointF source_point_;
   QPointF dest_point_;
   qreal arrow_size_;
+  QPolygonF arrow_head_;
 };
 
 #endif // EDGE_HPP
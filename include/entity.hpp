@@ -20,18 +20,21 @@
 #ifndef ENTITY_HPP
 #define ENTITY_HPP
 
+#include <atomic>
+#include <memory>
 #include <vector>
 #include <cassert>
 #include <functional>
 
 #include <QObject>
 #include <QString>
-#include <QProgressBar>
 
 #include "caf/intrusive_ptr.hpp"
 
 #include "fwd.hpp"
+#include "fiber.hpp"
 #include "simulant.hpp"
+#include "tick_time.hpp"
 #include "critical_section.hpp"
 
 /// An `entity` in a simulation.
@@ -39,12 +42,40 @@ class entity : public QObject {
 public:
   friend class simulant;
 
+  friend class environment;
+
   enum state_t {
     idle,
     read_mailbox,
     resume_simulant
   };
 
+  /// Configures the simulated computation of an entity. The details dialog
+  /// writes to this struct whenever the user changes one of its spin boxes.
+  struct parameters {
+    /// Ticks a source spends on generating a single item.
+    int source_rate = 1;
+    /// Ticks a sink or stage spends on consuming a single item.
+    int ticks_per_item = 1;
+    /// Number of consumed items per `ratio_out` produced items of a stage.
+    int ratio_in = 1;
+    /// Number of produced items per `ratio_in` consumed items of a stage.
+    int ratio_out = 1;
+    /// Share of credit this entity receives relative to other sources of the
+    /// same sink.
+    int source_weight = 1;
+  };
+
+  /// Plain representation of a progress bar.
+  struct progress_state {
+    int value = 0;
+    int maximum = 0;
+
+    inline bool at_max() const {
+      return value == maximum;
+    }
+  };
+
   entity(environment* env, QWidget* parent, QString name);
 
   virtual ~entity();
@@ -64,6 +95,34 @@ public:
   /// Advances time by one interval (after X ticks have been emitted).
   virtual void tock();
 
+  /// Renders the state of this entity into its model and dialog. The
+  /// environment calls this member function once per frame while the
+  /// simulation thread is paused.
+  void render();
+
+  /// Reports all ticks before `t` as idle that the environment did not visit
+  /// this entity for.
+  void report_idle_ticks(tick_time t);
+
+  /// Serializes the state of this entity and its simulant to `out`. The
+  /// state starts with the parameters, see `load_parameters`.
+  void save_state(state_writer& out);
+
+  /// Reads the parameters at the beginning of a state written by
+  /// `save_state`.
+  /// @returns `false` if `in` contains no parameters, `true` otherwise.
+  bool load_parameters(state_reader& in);
+
+  /// Returns whether this entity has work for the next tick.
+  inline bool busy() {
+    return state_ != idle || mailbox_ready();
+  }
+
+  /// Returns what computations are triggered by the next tick.
+  inline state_t state() const {
+    return state_;
+  }
+
   /// Returns a unique identifier for this entity.
   inline const QString& id() const {
     return name_;
@@ -81,6 +140,11 @@ public:
     return simulant_.get();
   }
 
+  /// Returns the position of this entity in creation order.
+  inline size_t rank() const {
+    return rank_;
+  }
+
   simulant_tree_model* model();
 
   caf::actor handle();
@@ -88,123 +152,83 @@ public:
   /// Returns `true` if at least one message is waiting in the mailbox.
   bool mailbox_ready();
 
+  /// Creates the details dialog. Requires a `QApplication` and a fully
+  /// constructed entity, since the dialog picks its widgets by entity type.
+  /// The environment calls this function on the first `show_dialog`.
+  void create_dialog();
+
   void show_dialog();
 
   inline void refresh_mailbox() {
     refresh_mailbox_ = true;
   }
 
+  /// Returns whether the mailbox changed since the last call and resets the
+  /// flag.
+  inline bool mailbox_changed() {
+    return refresh_mailbox_.exchange(false);
+  }
+
   /// Returns whether this entity started its task. This indicates
   /// that batches are emitted for sources and received for sinks.
   inline bool started() const {
     return started_;
   }
 
-signals:
-  /// Signals that no operation was performed during a tick interval.
-  void idling();
-
-  /// Signals that a new message was received.
-  /// @param id Ascending counter for unambiguous message identification.
-  void message_received(int id, caf::strong_actor_ptr from,
-                        caf::message content);
-
-  /// Signals that a messages was consumed.
-  /// @param id Ascending counter for unambiguous message identification.
-  void message_consumed(int id);
-
-protected:
-  template <class T>
-  static int val(const T* obj) {
-    return obj->value();
-  }
-
-  template <class T>
-  static void val(T* obj, int x) {
-    obj->setValue(x);
+  /// Returns the configuration of the simulated computation.
+  inline parameters& params() {
+    return params_;
   }
 
-  template <class T>
-  static int max(const T* obj) {
-    return obj->maximum();
+  /// Returns the progress for the current batch.
+  inline const progress_state& batch_progress() const {
+    return batch_progress_;
   }
 
-  template <class T>
-  static void max(T* obj, int x) {
-    obj->setMaximum(x);
+  /// Returns the progress for the current item.
+  inline const progress_state& item_progress() const {
+    return item_progress_;
   }
 
-  template <class T>
-  static void inc_max(T* obj) {
-    obj->setMaximum(obj->maximum() + 1);
-  }
-  template <class T>
-  static inline bool at_max(const T* obj) {
-    return val(obj) == max(obj);
+  /// Returns the ID of the entity that sent the current batch (if any).
+  inline const QString& current_sender() const {
+    return current_sender_;
   }
 
-  template <class T>
-  static void inc(T* obj, int value = 1) {
-    obj->setValue(obj->value() + value);
+  /// Returns the number of ticks this entity reported as idle.
+  inline tick_duration idle_ticks() const {
+    return idle_ticks_;
   }
 
-  template <class T>
-  static void dec(T* obj, int value = 1) {
-    obj->setValue(obj->value() - value);
-  }
-
-  template <class T>
-  static int enabled(T* obj) {
-    return obj->isEnabled();
-  }
-
-  template <class T>
-  static void enabled(T* obj, bool x) {
-    if (obj->isEnabled() != x)
-      obj->setEnabled(x);
-  }
-
-  template <class T>
-  static void enable(T* obj) {
-    enabled(obj, true);
-  }
-
-  template <class T>
-  static void disable(T* obj) {
-    enabled(obj, false);
-  }
-
-  template <class T>
-  static QString text(T* obj) {
-    return obj->text();
-  }
+signals:
+  /// Signals that no operation was performed during `ticks` tick intervals.
+  void idling(int ticks);
 
-  template <class T>
-  static void text(T* obj, QString x) {
-    obj->setText(x);
-  }
+  /// Signals that a new message was received.
+  /// @param id Ascending counter for unambiguous message identification.
+  void message_received(int id, caf::strong_actor_ptr from,
+                        caf::message content);
 
-  template <class T>
-  static void reset(T* obj, int value, int maximum) {
-    max(obj, maximum);
-    val(obj, value);
-  }
+  /// Signals that a messages was consumed.
+  /// @param id Ascending counter for unambiguous message identification.
+  void message_consumed(int id);
 
-  void progress(QProgressBar* bar, int first, int last);
+protected:
+  void progress(progress_state& st, int first, int last);
 
   template <class F>
-  void progress(QProgressBar* bar, int first, int last, F f) {
+  void progress(progress_state& st, int first, int last, F f) {
     if (first == last) {
-      val(bar, 0);
+      st.value = 0;
       return;
     }
-    max(bar, last);
+    st.maximum = last;
     for (int i = first; i != last; ++i) {
-      val(bar, i);
+      st.value = i;
       f(i);
       yield();
     }
-    val(bar, last);
+    st.value = last;
   }
 
   template <class Int, class F>
@@ -233,40 +257,21 @@ protected:
   // Our actor under test.
   caf::intrusive_ptr<simulant> simulant_;
 
-  std::mutex simulant_mx_;
-
   // Used to execute simulant_->resume in order to gain fine-grained control
   // over the execution of simulant_. This control is used to block-and-resume
   // the simulant's handling of stream messages.
-  std::thread simulant_thread_;
-
-  // Allows waiting for simulant_resume_.
-  std::condition_variable simulant_resume_cv_;
-
-  // Necessary guard for simulant_resume_cv_.
-  std::unique_lock<std::mutex>* simulant_resume_guard_;
-
-  enum simulant_thread_state {
-    sts_none,     // Signals the entity that simulant_thread_ is invalid.
-    sts_resume,   // Signals the simulant_thread_ to continue.
-    sts_yield,    // Signals the entity to continue.
-    sts_finalize, // Signals the entity to join and destroy simulant_thread_.
-    sts_abort     // Signals the simulant_thread_ to throw.
-  };
-
-  // Signals the entity to resume the simulant next tick.
-  std::atomic<simulant_thread_state> simulant_thread_state_;
+  std::unique_ptr<fiber> simulant_fiber_;
 
-  // Allows waiting for simulant_yield_.
-  std::condition_variable simulant_yield_cv_;
+  // Signals the simulant_fiber_ to throw when resumed.
+  bool abort_simulant_;
 
-  // Transfers control from the simulant thread back to the entity.
+  // Transfers control from the simulant fiber back to the entity.
   void yield();
 
-  // Transers control from the entity to the simulant thread.
+  // Transers control from the entity to the simulant fiber.
   void resume();
 
-  // Delegates processing of the next mailbox element via simulant_thread_.
+  // Delegates processing of the next mailbox element via simulant_fiber_.
   void start_handling_next_message();
 
   /// Controls what code is executed during a tick.
@@ -282,6 +287,32 @@ protected:
   /// to true when receiving the first batch.
   bool started_;
 
+  /// Configures the simulated computation.
+  parameters params_;
+
+  /// Tracks progress for the current batch.
+  progress_state batch_progress_;
+
+  /// Tracks progress for the current item.
+  progress_state item_progress_;
+
+  /// Stores the ID of the entity that sent the current batch.
+  QString current_sender_;
+
+  /// Position in the list of entities. The environment visits active
+  /// entities in this order.
+  size_t rank_;
+
+  /// Stores whether the environment visits this entity on the next tick.
+  bool scheduled_;
+
+  /// First tick that was neither visited by the environment nor reported as
+  /// idle.
+  tick_time idle_until_;
+
+  /// Sums up all ticks reported as idle.
+  tick_duration idle_ticks_;
+
 private:
   Q_OBJECT
 };
@@ -3,19 +3,28 @@
 
 #include <QDialog>
 
-#include "caf/message.hpp"
-#include "caf/actor_control_block.hpp"
-
 #include "fwd.hpp"
 
 #include "ui_entity_details.h"
 
+/// Renders the state of an entity. The dialog only reads from the entity
+/// and observes its state model while visible.
 class entity_details : public QDialog, public Ui::entity_details {
 public:
   explicit entity_details(entity* ptr);
 
   ~entity_details();
 
+  /// Renders the current progress, idle time and mailbox of the entity if
+  /// the dialog is visible.
+  void refresh();
+
+protected:
+  void showEvent(QShowEvent* event) override;
+
+  void hideEvent(QHideEvent* event) override;
+
+private:
   void drop_sink_widgets();
 
   void drop_stage_widgets();
@@ -24,19 +33,25 @@ public:
 
   void drop_source_only_widgets();
 
-public slots:
-  /// Handles messages received by entites.
-  void entity_received_message(int id, caf::strong_actor_ptr from,
-                               caf::message content);
+  void drop_by_prefix(const QString& prefix);
 
-  /// Handles messages consumed by entites.
-  void entity_consumed_message(int id);
+  /// Renders the current progress and idle time of the entity.
+  void render();
 
-private:
-  void drop_by_prefix(const QString& prefix);
+  /// Renders all messages in the mailbox of the entity.
+  void render_mailbox();
+
+  void bind(QSpinBox* x, int& field);
 
+  entity* entity_;
   environment* env_;
 
+  /// Stores whether widgets with prefix "sink" are still alive.
+  bool has_sink_widgets_;
+
+  /// Stores whether widgets with prefix "source" are still alive.
+  bool has_source_widgets_;
+
   Q_OBJECT
 };
 
@@ -6,9 +6,14 @@
 #include <vector>
 #include <cassert>
 #include <functional>
+#include <mutex>
 #include <random>
+#include <string>
+#include <thread>
 #include <unordered_map>
+#include <condition_variable>
 
+#include <QHash>
 #include <QApplication>
 
 #include "caf/fwd.hpp"
@@ -19,6 +24,11 @@
 #include "entity.hpp"
 #include "mainwindow.hpp"
 #include "tick_time.hpp"
+#include "timing_wheel.hpp"
+#include "checkpoint.hpp"
+#include "replay_log.hpp"
+#include "latency_stats.hpp"
+#include "message_tracker.hpp"
 
 /// Top-level Qt object for the simulation. Contains the CAF actor system.
 class environment : public QObject {
@@ -27,15 +37,120 @@ public:
 
   struct config : caf::actor_system_config {
     config();
+
+    /// Runs the simulation without any Qt widgets if set.
+    bool headless = false;
+
+    /// Number of simulated ticks in headless mode.
+    int ticks = 1000;
+
+    /// Initial topology for the simulation.
+    std::string layout = "src1,snk1";
+
+    /// Placement of nodes in the GUI, either "layered" or "force".
+    std::string graph_layout = "layered";
+
+    /// Advances time straight to the next scheduled event whenever all
+    /// entities are idle, instead of stepping through each idle tick.
+    bool skip_idle_ticks = false;
+
+    /// Writes binary trace records to this file if not empty.
+    std::string trace_file;
+
+    /// Records all message deliveries and tick events to this file if not
+    /// empty.
+    std::string record_file;
+
+    /// Replays the recording in this file if not empty. Overrides `layout`.
+    std::string replay_file;
+
+    /// Fast-forwards a replay to this tick before showing any results.
+    int replay_seek = 0;
+
+    /// Seeds the random number generator. Picks a random seed if 0.
+    int seed = 0;
+
+    /// Writes a checkpoint to this file if not empty.
+    std::string checkpoint_file;
+
+    /// Writes the checkpoint once the simulation reaches this tick.
+    int checkpoint_at = 0;
+
+    /// Re-simulates up to the tick of the checkpoint in this file and fails
+    /// unless the state matches it. Overrides `layout`.
+    std::string verify_file;
+
+    /// Default length of a credit cycle in term gatherers.
+    tick_duration cycle_duration = 100;
+
+    /// Default minimum number of tokens per cycle in term gatherers.
+    double min_tokens = 100;
+
+    /// Default desired processing time for a single batch in term gatherers.
+    tick_duration desired_batch_complexity = 20;
+
+    /// Default time batches should wait in the mailbox of a sink. The PID and
+    /// AIMD credit policies steer towards this delay.
+    tick_duration target_queueing_delay = 20;
+
+    /// Default minimum number of items per batch in term gatherers.
+    int min_batch_size = 5;
+
+    /// Hands credit that slow sources leave unused to backlogged sources
+    /// instead of splitting credit by weight only.
+    bool max_min_fairness = false;
+
+    /// Default credit policy of sinks: cycle, pid, aimd or static.
+    std::string credit_policy = "cycle";
+
+    /// Overrides the credit policy of individual sinks, e.g.,
+    /// "snk1=aimd,snk2=pid".
+    std::string credit_policies;
+
+    /// Runs a sweep with one grid point per credit policy.
+    bool compare_credit_policies = false;
+
+    /// Tunes batch sizes and cycle durations of sinks to keep batches below
+    /// this latency in ticks. Disabled if 0.
+    tick_duration latency_target = 0;
+
+    /// Runs a headless simulation for each point in this parameter grid,
+    /// e.g., "cycle-duration=50,100;min-tokens=10,100", if not empty.
+    std::string sweep;
+
+    /// Number of seeds per point in the parameter grid.
+    int sweep_seeds = 5;
+
+    /// Number of worker threads for a sweep. Uses all cores if 0.
+    int sweep_threads = 0;
+
+    /// Output file for the sweep report. Writes JSON if the file name ends
+    /// in ".json" and CSV otherwise.
+    std::string sweep_report = "sweep.csv";
   };
 
-  struct enqueued_message {
-    int id;
-    tick_time timestamp;
-    caf::strong_actor_ptr from;
-    caf::message content;
-    enqueued_message(int id, tick_time timestamp, caf::strong_actor_ptr from,
-                     caf::message content);
+  /// Aggregated metrics of a headless run.
+  struct run_summary {
+    /// Number of simulated ticks.
+    tick_time ticks = 0;
+
+    /// Consumed messages per tick.
+    double throughput = 0;
+
+    /// Average latency of consumed messages.
+    double avg_latency = 0;
+
+    /// Latency percentiles of consumed messages.
+    double p50 = 0;
+    double p99 = 0;
+    double p999 = 0;
+
+    /// Average idle percentage of sinks.
+    double idle = 0;
+
+    /// Average relative change of the token count between two credit cycles
+    /// of a sink.
+    double credit_oscillation = 0;
   };
 
   struct in_flight_message {
@@ -47,13 +162,7 @@ public:
 
   using entity_ptrs = std::vector<entity_ptr>;
 
-  using tick_durations = std::vector<tick_duration>;
-
-  using duration_samples = std::unordered_map<entity*, tick_durations>;
-
-  using enqueued_messages = std::vector<enqueued_message>;
-
-  using timestamped_messages = std::map<entity*, enqueued_messages>;
+  using latency_stats_map = std::unordered_map<entity*, latency_stats>;
 
   /// Represents an event (usually generated from simulant actors) that occurs
   /// during a tick and that should get executed between calling `tick()` and
@@ -89,7 +198,12 @@ public:
 
   using tick_events = std::vector<tick_event_uptr>;
 
-  using tick_events_map = std::map<tick_time, tick_events>;
+  using tick_event_queue = timing_wheel<tick_event_uptr>;
+
+  using network_queue = timing_wheel<in_flight_message>;
+
+  /// Maps sources to their consumers.
+  using edge_map = std::map<source*, entity*>;
 
   // -- Construction, destruction, and assignment ------------------------------
 
@@ -101,8 +215,31 @@ public:
 
   // -- Simulation control functions -------------------------------------------
 
-  /// Runs the simulation.
-  void run();
+  /// Runs the simulation, either with GUI or headless depending on the
+  /// configuration.
+  /// @returns `false` if the simulation failed to start or to verify a
+  ///          checkpoint, `true` otherwise.
+  bool run();
+
+  /// Runs `f` while the simulation thread waits between two ticks, i.e.,
+  /// `f` has exclusive access to all entities and their simulants. Runs `f`
+  /// immediately if no simulation thread exists or when called from it.
+  template <class F>
+  void synchronized(F f) {
+    if (!worker_.joinable() || std::this_thread::get_id() == worker_.get_id()) {
+      f();
+      return;
+    }
+    pause_worker();
+    f();
+    resume_worker();
+  }
+
+  /// Runs the simulation for the configured number of ticks without GUI and
+  /// stores aggregated metrics in `result`. Prints metrics for all entities
+  /// if `print` is set.
+  /// @returns An error message on failure, an empty string otherwise.
+  QString simulate(run_summary& result, bool print);
 
   // -- Setup functions --------------------------------------------------------
 
@@ -112,11 +249,20 @@ public:
   T* make_entity(Ts&&... xs) {
     assert(!running_);
     auto ptr = new T(this, std::forward<Ts>(xs)...);
+    ptr->rank_ = entities_.size();
     connect_slots(ptr, std::is_same<T, sink>::value);
     entities_.emplace_back(ptr);
+    index_entity(ptr);
     return ptr;
   }
 
+  /// Creates all entities for `layout` and connects sources to their
+  /// consumers. A layout such as "src1,stg1,snk1;src2,-,snk1" describes a
+  /// matrix, where ',' separates columns and ';' separates rows.
+  /// @returns An error message on failure, an empty string otherwise.
+  /// @warning Illegal to call while running the simulation.
+  QString load_layout(QWidget* parent, const QString& layout);
+
   /// Returns an existing entity or creates a new entity if necessary.
   template <class T, class... Ts>
   T* get_entity(QWidget* parent, const QString& id, Ts&&... xs) {
@@ -141,11 +287,41 @@ public:
     return entities_;
   }
 
+  /// Returns all connections between sources and their consumers.
+  inline const edge_map& edges() const {
+    return edges_;
+  }
+
   /// Returns the host actor system.
   inline caf::actor_system& sys() {
     return sys_;
   }
 
+  /// Returns whether the simulation runs without GUI.
+  inline bool headless() const {
+    return cfg_.headless;
+  }
+
+  /// Returns the initial topology for the simulation.
+  inline const std::string& layout() const {
+    return cfg_.layout;
+  }
+
+  /// Returns the configuration of the simulation.
+  inline const config& cfg() const {
+    return cfg_;
+  }
+
+  /// Returns the minimum delay for transmitting messages.
+  inline tick_duration min_delay() const {
+    return min_delay_;
+  }
+
+  /// Returns the maximum delay for transmitting messages.
+  inline tick_duration max_delay() const {
+    return max_delay_;
+  }
+
   /// Returns the entity associated with `x`.
   entity* entity_by_id(const QString& x) const;
 
@@ -160,6 +336,14 @@ public:
     return id_by_handle(caf::actor_cast<caf::actor_addr>(x));
   }
 
+  /// Returns the rank of the entity for `x` or -1.
+  int32_t rank_of(const caf::actor_addr& x) const;
+
+  /// Returns the rank of the entity for `x` or -1.
+  inline int32_t rank_of(const caf::strong_actor_ptr& x) const {
+    return rank_of(caf::actor_cast<caf::actor_addr>(x));
+  }
+
   /// Returns whether `id` refers to a known entity.
   inline bool has_entity(const QString& id) const {
     return entity_by_id(id) != nullptr;
@@ -178,6 +362,21 @@ public:
   /// Returns the average latency for all entites.
   tick_duration average_global_latency();
 
+  /// Returns the latency at quantile `q` (e.g., 0.99 for p99) for `x`.
+  tick_duration latency_percentile(entity* x, double q);
+
+  /// Returns the latency at quantile `q` (e.g., 0.99 for p99) for all
+  /// entities.
+  tick_duration global_latency_percentile(double q);
+
+  /// Returns aggregated latency statistics for `x`.
+  const latency_stats& latency(entity* x);
+
+  /// Returns aggregated latency statistics for all entities.
+  inline const latency_stats& global_latency() const {
+    return global_latency_;
+  }
+
   /// Returns what percentage of time `x` is idle.
   double idle_percentage(entity* x);
 
@@ -210,33 +409,84 @@ public:
     post(make_tick_event<F>(std::move(fun)));
   }
 
-  // Returns a random delay with bounds configured in the main window.
+  /// Draws a delay between `min_delay()` and `max_delay()` from `rng_`.
+  /// @pre The caller holds `rng_mtx_`.
   tick_duration random_delay();
 
-public slots:
-  /// Triggers a single computation step.
-  void tick();
+  /// Schedules `x` for the next tick. Only scheduled entities are visited by
+  /// `tick()`, i.e., entities without work cost nothing.
+  void activate(entity* x);
 
-  /// Triggers `manual_tick_count` computation steps.
-  void manual_tick();
+  /// Prints latency and idle statistics for all entities to `STDOUT`.
+  void print_metrics();
+
+  /// Prints how much memory entities and their dialogs occupy to `STDOUT`.
+  void print_memory_usage();
+
+  /// Creates the details dialog of `x` and keeps track of its memory usage.
+  void create_dialog(entity* x);
+
+  /// Stores the current state of the simulation in `x`.
+  void save_state(checkpoint& x);
+
+  /// Returns the name of the credit policy for sink `x`.
+  std::string credit_policy_of(const entity* x) const;
+
+  /// Records the token count of sink `x` for a new credit cycle.
+  void record_tokens(entity* x, long tokens);
+
+  /// Returns the average relative change of the token count between two
+  /// credit cycles over all sinks.
+  double credit_oscillation() const;
+
+  /// Stores when `x` received message `id` in `t`.
+  /// @returns `false` if `x` consumed `id` already, `true` otherwise.
+  bool receive_time(entity* x, int id, tick_time& t);
+
+  // -- callbacks for entities -------------------------------------------------
 
   /// Handles idle entites.
-  void sink_idling();
+  void sink_idling(entity* x, int ticks);
 
   /// Handles messages received by entites.
-  void entity_received_message(int id, caf::strong_actor_ptr from,
+  void entity_received_message(entity* x, int id, caf::strong_actor_ptr from,
                                caf::message content);
 
   /// Handles messages consumed by entites.
-  void entity_consumed_message(int id);
+  void entity_consumed_message(entity* x, int id);
+
+public slots:
+  /// Sets the minimum delay for transmitting messages.
+  void min_delay(int x);
+
+  /// Sets the maximum delay for transmitting messages.
+  void max_delay(int x);
+
+  /// Sets how many ticks per second the simulation thread runs. A value of 0
+  /// only runs manual ticks and a negative value runs as fast as possible.
+  void tick_rate(int x);
+
+  /// Triggers `manual_tick_count` computation steps.
+  void manual_tick();
+
+  /// Renders the current state of the simulation.
+  void render_frame();
 
 signals:
   /// Emitted when a new latency sample is added and the average is recomputed.
   void average_global_latency_changed(int value);
 
-  /// Emitted when a new latency sample is added and the average is recomputed.
+  /// Emitted once per rendered frame with the average latency of `receiver`.
   void average_latency_changed(entity* receiver, int value);
 
+  /// Emitted when tick time changes and the percentiles are recomputed.
+  void global_latency_percentiles_changed(int p50, int p99, int p999);
+
+  /// Emitted once per rendered frame with the latency percentiles of
+  /// `receiver`.
+  void latency_percentiles_changed(entity* receiver, int p50, int p99,
+                                   int p999);
+
   /// Emitted when tick time changes and the percentage of reported idle times
   /// is recomputed.
   void average_global_idle_percentage_changed(double percentage);
@@ -248,7 +498,58 @@ signals:
 private:
   double idle_percentage(tick_duration x);
 
-  void tick(bool silent);
+  /// Runs a single computation step.
+  void tick();
+
+  /// Runs ticks until the simulation time reaches `t`. Skips idle ticks if
+  /// configured.
+  void run_until(tick_time t);
+
+  /// Returns whether no entity has anything to do during the next tick.
+  inline bool quiescent() const {
+    return active_.empty();
+  }
+
+  /// Brings the idle times of all entities up to date.
+  void flush_idle_times();
+
+  /// Adds `x` to the lookup tables for IDs and handles.
+  void index_entity(entity* x);
+
+  /// Destroys all entities and clears any state associated to them.
+  void clear_entities();
+
+  /// Advances time to the next scheduled message or event, but not beyond
+  /// `limit` or a pending checkpoint, if all entities are idle.
+  void skip_idle_ticks(tick_time limit);
+
+  /// Runs the simulation with `QApplication` and `MainWindow`.
+  bool run_gui();
+
+  /// Runs ticks on the simulation thread until `stop_worker` gets called.
+  void run_worker();
+
+  /// Makes the simulation thread return from `run_worker` and joins it.
+  void stop_worker();
+
+  /// Blocks until the simulation thread waits between two ticks.
+  void pause_worker();
+
+  /// Allows the simulation thread to continue after `pause_worker`.
+  void resume_worker();
+
+  /// Runs the simulation for the configured number of ticks without GUI.
+  bool run_headless();
+
+  /// Runs a headless simulation for each point of the configured parameter
+  /// grid and writes a report.
+  /// @returns `false` if the grid is invalid or the report cannot be
+  ///          written, `true` otherwise.
+  bool run_sweep();
+
+  /// Starts all entities and runs all events of "tick 0".
+  /// @returns an error message if verifying the checkpoint failed.
+  QString start_entities();
 
   void connect_slots(MainWindow* x);
 
@@ -256,33 +557,98 @@ private:
 
   void run_tick_events();
 
+  /// Delivers all messages from the network queue that are due this tick.
+  void deliver_messages();
+
+  /// Reports that the simulation no longer matches the replay log and
+  /// continues without it.
+  void replay_diverged();
+
+  /// Writes the configured checkpoint file.
+  void write_checkpoint();
+
+  /// Applies the entity parameters stored in `verify_` before starting the
+  /// entities.
+  void apply_checkpoint_parameters();
+
+  /// Fast-forwards to the tick of `verify_` and compares the resulting state
+  /// with the checkpoint.
+  /// @returns an error message if the states differ.
+  QString verify_checkpoint();
+
   config cfg_;
+
+  /// Stores the CLI arguments for spawning sweep runs.
+  std::vector<std::string> args_;
+
   caf::actor_system sys_;
   entity_ptrs entities_;
+
+  /// Maps entity IDs to entities.
+  QHash<QString, entity*> entities_by_id_;
+
+  /// Maps actor IDs of simulants to their entities.
+  std::unordered_map<caf::actor_id, entity*> entities_by_handle_;
   std::unique_ptr<MainWindow> main_window_;
   bool running_;
 
+  /// Connects sources to their consumers.
+  edge_map edges_;
+
+  /// Stores the layout of the current entities.
+  std::string layout_;
+
+  /// Stores all entities that have work for the next tick.
+  std::vector<entity*> active_;
+
+  /// Stores all entities visited during the current tick.
+  std::vector<entity*> visited_;
+
+  /// Lower bound for message delays in `transmit()`.
+  tick_duration min_delay_;
+
+  /// Upper bound for message delays in `transmit()`.
+  tick_duration max_delay_;
+
   /// Keeps track of the current tick count,  i.e., the current timestamp.
   tick_time time_;
 
-  /// Stores unprocessed messages with delivery timestamp.
-  timestamped_messages enqueued_messages_;
+  /// Stores receive timestamps of unprocessed messages, indexed by the rank of
+  /// the receiving entity.
+  std::vector<message_tracker> in_flight_;
+
+  /// Keeps track of reported latency times per entity.
+  latency_stats_map latency_stats_;
 
-  /// Keeps track of reported latency times.
-  duration_samples latency_samples_;
+  /// Keeps track of reported latency times for all entities.
+  latency_stats global_latency_;
 
   /// Keeps track of reported idle times.
   std::unordered_map<entity*, tick_duration> idle_times_;
 
+  /// Token counts of a sink across credit cycles.
+  struct token_stats {
+    long last = 0;
+    long cycles = 0;
+    double sum = 0;
+    double sum_of_changes = 0;
+  };
+
+  /// Keeps track of reported token counts.
+  std::unordered_map<entity*, token_stats> token_stats_;
+
+  /// Maps entity IDs to credit policies that override the default.
+  QHash<QString, std::string> credit_policies_;
+
   /// Simulates a "network" by delaying messages.
-  std::multimap<tick_time, in_flight_message> network_queue_;
+  network_queue network_queue_;
 
-  /// Protects access to `delivery_queue_`.
+  /// Protects access to `network_queue_`.
   std::mutex network_queue_mtx_;
 
   /// Stores events that occur during `tick()` and must get executed before
   /// `after_tick()`.
-  tick_events_map tick_events_;
+  tick_event_queue tick_events_;
 
   /// Protects access to `tick_events`.
   std::mutex tick_events_mtx_;
@@ -290,9 +656,61 @@ private:
   /// Generates a random seed.
   std::random_device rng_device_;
 
+  /// Seeds `rng_` whenever starting the entities.
+  uint32_t seed_;
+
   /// Pseudo-random number generator.
   std::mt19937 rng_;
 
+  /// Protects `rng_` as well as the log in `recorder_` or `replayer_`.
+  std::mutex rng_mtx_;
+
+  /// Writes a replay log while recording.
+  std::unique_ptr<replay_log_writer> recorder_;
+
+  /// Feeds the simulation from a replay log while replaying.
+  std::unique_ptr<replay_log_reader> replayer_;
+
+  /// Stores the checkpoint to verify after the next start of the entities.
+  std::unique_ptr<checkpoint> verify_;
+
+  /// Stores whether the configured checkpoint is not written yet.
+  bool checkpoint_pending_;
+
+  /// Resident memory allocated while loading the current layout.
+  size_t entity_memory_;
+
+  /// Resident memory allocated while creating dialogs.
+  size_t dialog_memory_;
+
+  /// Number of created dialogs.
+  size_t num_dialogs_;
+
+  /// Runs the simulation in GUI mode, while the GUI thread only renders.
+  std::thread worker_;
+
+  /// Protects all of the following members.
+  std::mutex worker_mtx_;
+
+  /// Signals changes to any of the following members.
+  std::condition_variable worker_cv_;
+
+  /// Ticks per second for the simulation thread. A value of 0 only runs
+  /// manual ticks and a negative value runs as fast as possible.
+  int tick_rate_;
+
+  /// Runs ticks until reaching this time, regardless of `tick_rate_`.
+  tick_time tick_target_;
+
+  /// Number of pending calls to `pause_worker`.
+  int pause_requests_;
+
+  /// Stores whether the simulation thread waits between two ticks.
+  bool worker_paused_;
+
+  /// Stores whether the simulation thread shall return.
+  bool worker_shutdown_;
+
   Q_OBJECT
 };
 
@@ -0,0 +1,50 @@
+#ifndef FIBER_HPP
+#define FIBER_HPP
+
+#include <memory>
+#include <exception>
+#include <functional>
+
+/// A stackful coroutine that runs on the thread calling `resume()`. Switching
+/// between a fiber and its caller is a plain context swap without involving
+/// the OS scheduler. Stacks are recycled through a thread-local pool.
+class fiber {
+public:
+  fiber(std::function<void()> f);
+
+  fiber(const fiber&) = delete;
+
+  fiber& operator=(const fiber&) = delete;
+
+  ~fiber();
+
+  /// Runs the fiber until it either calls `yield()` or returns. Rethrows any
+  /// exception that escapes the fiber.
+  /// @returns `true` if the fiber has finished, `false` otherwise.
+  bool resume();
+
+  /// Transfers control back to the caller of `resume()`.
+  /// @warning Must only be called from within the fiber.
+  void yield();
+
+  /// Returns whether the fiber has finished.
+  inline bool done() const {
+    return done_;
+  }
+
+  /// Size of a single fiber stack in bytes.
+  static constexpr size_t stack_size = 256 * 1024;
+
+private:
+  struct context;
+
+  static void trampoline();
+
+  std::function<void()> f_;
+  std::unique_ptr<context> ctx_;
+  std::exception_ptr eptr_;
+  bool started_;
+  bool done_;
+};
+
+#endif // FIBER_HPP
@@ -19,5 +19,7 @@ class simulant_tree_model;
 class sink;
 class source;
 class stage;
+class state_reader;
+class state_writer;
 
 #endif // FWD_HPP
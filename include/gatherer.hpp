@@ -1,12 +1,19 @@
 #ifndef GATHERER_HPP
 #define GATHERER_HPP
 
+#include <unordered_map>
+
 #include "caf/random_gatherer.hpp"
 
 #include "fwd.hpp"
 #include "tick_time.hpp"
 #include "rate_controlled_sink.hpp"
 
+/// Assigns credit to the inbound paths of a stage. Each path has a rate that
+/// a PID controller adjusts after each batch, based on the measured
+/// processing rate and the time the batch waited in the mailbox. The credit
+/// of a path covers the elements that arrive at this rate within one credit
+/// interval.
 class gatherer : public caf::random_gatherer {
 public:
   using super = caf::random_gatherer;
@@ -15,7 +22,7 @@ public:
   gatherer(caf::local_actor* self, Scatterer& out)
       : super(self, out),
         parent_(static_cast<simulant*>(self)->parent()) {
-    // nop
+    init();
   }
 
   ~gatherer() override;
@@ -24,29 +31,63 @@ public:
 
   long initial_credit(long downstream_capacity, path_ptr x) override;
 
-  void batch_completed(caf::inbound_path* from, size_t xs_size, int64_t id);
+  bool remove_path(const caf::stream_id& sid, const caf::actor_addr& x,
+                   caf::error reason, bool silent) override;
+
+  /// Returns whether `x` is an open inbound path of this gatherer.
+  bool contains(caf::inbound_path* x) const;
+
+  /// Records completion of a batch with `xs_size` elements from `from` that
+  /// arrived at `enqueue_time` and got processed between `start_time` and
+  /// `end_time`.
+  void batch_completed(caf::inbound_path* from, long xs_size,
+                       tick_time enqueue_time, tick_time start_time,
+                       tick_time end_time);
+
+  /// Returns the rate of `x` in elements per second or 0 if `x` completed no
+  /// batch yet.
+  double rate(caf::inbound_path* x) const;
+
+  /// Serializes the configuration and controller state to `out`.
+  void save_state(state_writer& out) const;
+
+  /// Loads the static configuration from the environment.
+  void init();
 
 private:
+  /// Returns how much credit `x` should have at most.
+  long desired_credit(caf::inbound_path* x) const;
+
+  void update_rate(caf::inbound_path* from, tick_time time,
+                   size_t num_elements, tick_duration processing_delay,
+                   tick_duration scheduling_delay);
+
   entity* parent_;
 
   double proportional_ = 1;
   double integral_ = .2;
   double derivative_ = 0;
+
+  /// Lower bound for the rate in elements per second.
   double min_rate_ = 100;
 
+  /// Time span covered by the credit of a path.
+  tick_duration credit_interval_ = 100;
+
+  /// Credit for paths without a rate.
+  long initial_credit_ = 100;
+
+  /// Minimum credit per path, i.e., the smallest useful batch.
+  long min_credit_ = 5;
+
   /// State for computing the rate using a PID controller.
   struct rate_state {
-    tick_duration last_time_;
-    tick_duration batch_interval_;
+    tick_time last_time_;
     double last_rate_;
     double last_err_;
   };
 
   std::unordered_map<caf::inbound_path*, rate_state> rate_states_;
-
-  void update_rate(caf::inbound_path* from, tick_duration time,
-                   size_t num_elements, tick_duration processing_delay,
-                   tick_duration scheduling_delay);
 };
 
 #endif // GATHERER_HPP
@@ -0,0 +1,69 @@
+#ifndef LATENCY_STATS_HPP
+#define LATENCY_STATS_HPP
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "tick_time.hpp"
+
+/// Aggregates latency samples incrementally. Besides count, sum, minimum and
+/// maximum, this class keeps an HDR-style histogram with logarithmic buckets,
+/// where each power of two is divided into 32 linear sub-buckets. Hence,
+/// percentiles have a relative error of at most ~3% and memory usage only
+/// depends on the magnitude of the largest sample.
+class latency_stats {
+public:
+  latency_stats();
+
+  /// Adds a new sample.
+  void record(tick_duration x);
+
+  /// Removes all samples.
+  void reset();
+
+  /// Returns the number of recorded samples.
+  inline uint64_t count() const {
+    return count_;
+  }
+
+  /// Returns the sum of all recorded samples.
+  inline int64_t sum() const {
+    return sum_;
+  }
+
+  /// Returns the smallest recorded sample or 0 if no sample exists.
+  inline tick_duration min() const {
+    return count_ > 0 ? min_ : 0;
+  }
+
+  /// Returns the largest recorded sample or 0 if no sample exists.
+  inline tick_duration max() const {
+    return max_;
+  }
+
+  /// Returns the average of all recorded samples or 0 if no sample exists.
+  tick_duration mean() const;
+
+  /// Returns the sample at quantile `q` (e.g., 0.99 for p99) or 0 if no
+  /// sample exists.
+  tick_duration percentile(double q) const;
+
+  /// Returns the histogram buckets.
+  inline const std::vector<uint64_t>& buckets() const {
+    return buckets_;
+  }
+
+private:
+  static size_t bucket_of(tick_duration x);
+
+  static tick_duration highest_value_of(size_t bucket);
+
+  uint64_t count_;
+  int64_t sum_;
+  tick_duration min_;
+  tick_duration max_;
+  std::vector<uint64_t> buckets_;
+};
+
+#endif // LATENCY_STATS_HPP
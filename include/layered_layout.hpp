@@ -0,0 +1,32 @@
+#ifndef LAYERED_LAYOUT_HPP
+#define LAYERED_LAYOUT_HPP
+
+#include <vector>
+#include <cstddef>
+#include <utility>
+
+/// Position of a node in a layered drawing.
+struct layer_position {
+  /// Longest distance from any source, i.e., the depth in the pipeline.
+  size_t layer;
+
+  /// Position within the layer.
+  size_t order;
+
+  /// Number of nodes in the layer.
+  size_t layer_size;
+};
+
+/// Computes a layered (Sugiyama-style) drawing of a DAG with `num_nodes`
+/// nodes and directed `edges` between node indexes. Assigns each node to the
+/// layer of its longest path from a source and then reduces edge crossings by
+/// sorting each layer by the barycenter of its neighbors, alternating between
+/// downward and upward sweeps. Nodes initially appear in index order, i.e.,
+/// the result only depends on the input. Runs in O(sweeps * E log V).
+/// Nodes on a cycle end up in the first layer.
+std::vector<layer_position>
+layered_layout(size_t num_nodes,
+               const std::vector<std::pair<size_t, size_t>>& edges,
+               int sweeps = 4);
+
+#endif // LAYERED_LAYOUT_HPP
@@ -41,32 +41,33 @@ public:
 
   ~MainWindow();
 
+  /// Starts rendering frames.
   void start();
 
-  void before_tick();
-
-  void tick();
-
-  void after_tick();
-
-  void tock();
+  /// Renders the current simulation time. The environment calls this member
+  /// function once per frame while the simulation thread is paused.
+  void render();
 
 signals:
 
-  void tick_triggered();
+  void tick_rate_changed(int);
 
   void manual_tick_triggered();
 
+  void frame_triggered();
+
 public slots:
 
   void manual_tick_count_changed(int);
 
+  void as_fast_as_possible_toggled(bool);
+
 private:
   void load_layout(QTextStream& in);
   void load_default_view();
 
   environment* env_;
-  QTimer* timer;
+  QTimer* frame_timer;
 };
 
 #endif // MAINWINDOW_HPP
@@ -0,0 +1,59 @@
+#ifndef MESSAGE_TRACKER_HPP
+#define MESSAGE_TRACKER_HPP
+
+#include <deque>
+#include <cstddef>
+
+#include "tick_time.hpp"
+
+/// Keeps track of messages that an entity received but did not consume yet.
+/// Simulants number their messages with a dense, ascending counter. Hence,
+/// the tracker stores receive timestamps in a window of slots indexed by
+/// message ID instead of searching a list.
+class message_tracker {
+public:
+  message_tracker();
+
+  /// Stores the receive timestamp `t` for message `id`.
+  /// @returns `false` if `id` is already tracked, `true` otherwise.
+  bool add(int id, tick_time t);
+
+  /// Stores the receive timestamp of message `id` in `t`.
+  /// @returns `false` if `id` is not tracked, `true` otherwise.
+  bool find(int id, tick_time& t) const;
+
+  /// Removes message `id` and stores its receive timestamp in `t`.
+  /// @returns `false` if `id` is not tracked, `true` otherwise.
+  bool remove(int id, tick_time& t);
+
+  /// Returns the number of tracked messages.
+  inline size_t size() const {
+    return size_;
+  }
+
+  /// Calls `f(id, t)` for all tracked messages in ascending order.
+  template <class F>
+  void for_each(F f) const {
+    for (size_t i = 0; i < slots_.size(); ++i)
+      if (slots_[i] != none)
+        f(first_id_ + static_cast<int>(i), slots_[i]);
+  }
+
+  /// Removes all tracked messages.
+  void clear();
+
+private:
+  /// Marks unused slots.
+  static constexpr tick_time none = -1;
+
+  /// ID of the message in the first slot.
+  int first_id_;
+
+  /// Stores receive timestamps, starting at `first_id_`.
+  std::deque<tick_time> slots_;
+
+  /// Number of slots not set to `none`.
+  size_t size_;
+};
+
+#endif // MESSAGE_TRACKER_HPP
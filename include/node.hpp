@@ -8,6 +8,8 @@
 
 #include "fwd.hpp"
 
+class quadtree;
+
 /// A node is represented by a circle.
 class node : public QGraphicsItem {
 public:
@@ -55,7 +57,15 @@ public:
 
   bool advance();
 
-  void calculateForces();
+  /// Computes the next position of this node from the repulsion of all nodes
+  /// in `nodes` and the attraction of its edges.
+  void calculateForces(const quadtree& nodes);
+
+  /// Returns the squared distance to the next position.
+  inline qreal energy() const {
+    auto d = new_pos_ - pos();
+    return d.x() * d.x() + d.y() * d.y();
+  }
 
   QRectF boundingRect() const override;
 
@@ -0,0 +1,68 @@
+#ifndef QUADTREE_HPP
+#define QUADTREE_HPP
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include <QPointF>
+
+/// Approximates the repulsion between all pairs of points in O(n log n) with
+/// the Barnes-Hut algorithm. Each cell of the tree stores the number of points
+/// in its area and their center of mass. A cell that appears small from the
+/// point of view of a query, i.e., its width divided by its distance falls
+/// below `theta`, acts as a single point with the combined mass.
+class quadtree {
+public:
+  /// @param theta Accuracy of the approximation. A value of 0 visits every
+  ///        single point, larger values merge more points into clusters.
+  explicit quadtree(qreal theta = 0.8);
+
+  /// Discards all points and inserts `xs`.
+  void build(const std::vector<QPointF>& xs);
+
+  /// Returns the sum of `(p - q) * strength / |p - q|^2` over all points `q`
+  /// in the tree. Skips points at the position of `p`.
+  QPointF repulsion(QPointF p, qreal strength) const;
+
+  /// Returns the number of points in the tree.
+  inline size_t size() const {
+    return cells_.empty() ? 0 : static_cast<size_t>(cells_.front().mass);
+  }
+
+private:
+  struct cell {
+    /// Center of the square area.
+    qreal cx;
+    qreal cy;
+
+    /// Half of the width of the square area.
+    qreal half;
+
+    /// Center of mass of all points in this cell.
+    qreal mx;
+    qreal my;
+
+    /// Number of points in this cell.
+    qreal mass;
+
+    /// Indexes of the four children in `cells_` or 0 for leaves, since the
+    /// root is never a child.
+    uint32_t children[4];
+  };
+
+  /// Inserts a point into the cell at `pos`.
+  void insert(uint32_t pos, qreal x, qreal y, int depth);
+
+  /// Returns the index of a new child of `pos` for the quadrant of `(x, y)`.
+  uint32_t make_child(uint32_t pos, qreal x, qreal y);
+
+  /// Returns the quadrant of `(x, y)` in `c`.
+  static int quadrant(const cell& c, qreal x, qreal y);
+
+  qreal theta_;
+
+  std::vector<cell> cells_;
+};
+
+#endif // QUADTREE_HPP
@@ -3,14 +3,21 @@
 
 #include "entity.hpp"
 #include "tick_time.hpp"
+#include "rate_meter.hpp"
 
+/// A sink that keeps track of how many elements it sent downstream.
 class rate_controlled_sink {
 public:
   virtual ~rate_controlled_sink();
 
-  virtual void batch_sent(tick_time tstamp, size_t num_elements) = 0;
+  /// Records a batch with `num_elements` sent at `tstamp`.
+  virtual void batch_sent(tick_time tstamp, size_t num_elements);
 
-  virtual double last_rate(tick_time tstamp) = 0;
+  /// Returns the number of elements sent within the last second.
+  virtual double last_rate(tick_time tstamp);
+
+protected:
+  rate_meter send_rate_;
 };
 
 #endif // RATE_CONTROLLED_SINK_HPP
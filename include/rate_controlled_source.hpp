@@ -1,6 +1,8 @@
 #ifndef RATE_CONTROLLED_SOURCE_HPP
 #define RATE_CONTROLLED_SOURCE_HPP
 
+#include "caf/fwd.hpp"
+
 #include "entity.hpp"
 #include "tick_time.hpp"
 
@@ -8,10 +10,11 @@ class rate_controlled_source {
 public:
   virtual ~rate_controlled_source();
 
-  /// Records completion of a batch and updates the rate calculation based on
-  /// the observed computation or wait time.
-  virtual void batch_completed(long xs_size, tick_time enqueue_time,
-                               tick_time start_time, tick_time end_time) = 0;
+  /// Records completion of a batch from `from` and updates the rate
+  /// calculation based on the observed computation or wait time.
+  virtual void batch_completed(caf::inbound_path* from, long xs_size,
+                               tick_time enqueue_time, tick_time start_time,
+                               tick_time end_time) = 0;
 
   /// Generates tokens for the next interval.
   virtual long generate_tokens(tick_time now) = 0;
@@ -0,0 +1,85 @@
+#ifndef RATE_METER_HPP
+#define RATE_METER_HPP
+
+#include <vector>
+#include <cstddef>
+#include <utility>
+
+#include "tick_time.hpp"
+
+/// Measures how many elements passed within a sliding time window. Samples
+/// live in a ring buffer with fixed capacity and the meter keeps a running
+/// sum of all samples in the window. Hence, `add` and `rate` run in amortized
+/// O(1) and the meter never allocates after construction. Timestamps must be
+/// monotonically increasing. Once the buffer is full, the oldest sample drops
+/// out of the window early.
+class rate_meter {
+public:
+  /// @param window Size of the sliding window in ticks.
+  /// @param capacity Maximum number of samples in the window.
+  explicit rate_meter(tick_duration window = 1000000, size_t capacity = 1024);
+
+  /// Adds `num_elements` at time `tstamp`.
+  void add(tick_time tstamp, size_t num_elements);
+
+  /// Returns the number of elements in the window ending at `tstamp`.
+  size_t count(tick_time tstamp);
+
+  /// Returns the number of elements per second in the window ending at
+  /// `tstamp`.
+  double rate(tick_time tstamp);
+
+  /// Returns the size of the sliding window in ticks.
+  inline tick_duration window() const {
+    return window_;
+  }
+
+  /// Returns the number of samples in the window.
+  inline size_t size() const {
+    return size_;
+  }
+
+private:
+  using sample = std::pair<tick_time, size_t>;
+
+  /// Drops all samples at or before `t0`.
+  void expire(tick_time t0);
+
+  /// Drops the oldest sample.
+  void pop();
+
+  tick_duration window_;
+  std::vector<sample> buf_;
+  size_t first_;
+  size_t size_;
+  size_t sum_;
+};
+
+/// Measures a rate as exponentially weighted moving average. Each element
+/// contributes to the rate with a weight that decays by a factor of `e` every
+/// `tau` ticks. Unlike `rate_meter`, this meter needs constant memory
+/// regardless of the number of samples, but it never forgets a burst
+/// completely.
+class ewma_rate_meter {
+public:
+  /// @param tau Time constant of the decay in ticks.
+  explicit ewma_rate_meter(tick_duration tau = 1000000);
+
+  /// Adds `num_elements` at time `tstamp`.
+  void add(tick_time tstamp, size_t num_elements);
+
+  /// Returns the number of elements per second at `tstamp`.
+  double rate(tick_time tstamp) const;
+
+  /// Returns the time constant in ticks.
+  inline tick_duration tau() const {
+    return tau_;
+  }
+
+private:
+  tick_duration tau_;
+  tick_time last_;
+  double rate_;
+};
+
+#endif // RATE_METER_HPP
@@ -0,0 +1,184 @@
+#ifndef REPLAY_LOG_HPP
+#define REPLAY_LOG_HPP
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <utility>
+
+#include "tick_time.hpp"
+
+/// Identifies the kind of an entry in a replay log.
+enum class replay_entry : uint8_t {
+  /// A message was transmitted to an entity.
+  /// args: rank of the receiver (or -1), delay in ticks
+  delivery,
+  /// An event was posted to the tick event queue.
+  /// args: delay in ticks
+  tick_event
+};
+
+// Replay logs start with a header consisting of the magic number, a format
+// version, the seed of the random number generator and the layout. Entries
+// are grouped into frames, one per tick that has at least one entry. A frame
+// consists of its tick (as delta to the previous frame), its size in bytes
+// and its entries. All integers are varint encoded. When closing a log, the
+// writer appends a sparse index that maps ticks to frame offsets, followed by
+// a fixed-size trailer that stores the offset of the index.
+
+/// Magic number at the beginning of a replay log.
+constexpr char replay_log_magic[] = "SSREPLAY";
+
+/// Magic number at the end of a replay log with index.
+constexpr char replay_log_index_magic[] = "SSRPLIDX";
+
+/// Writes a replay log while running a simulation.
+class replay_log_writer {
+public:
+  replay_log_writer();
+
+  ~replay_log_writer();
+
+  replay_log_writer(const replay_log_writer&) = delete;
+
+  replay_log_writer& operator=(const replay_log_writer&) = delete;
+
+  /// Creates the log at `path` and writes the header.
+  /// @returns `false` if the file cannot be created, `true` otherwise.
+  bool open(const std::string& path, uint32_t seed, const std::string& layout);
+
+  /// Writes any pending frame as well as the index and closes the file.
+  void close();
+
+  /// Records that a message for entity `receiver` was transmitted at tick `t`
+  /// with a delay of `delay` ticks.
+  void delivery(tick_time t, int32_t receiver, tick_duration delay);
+
+  /// Records that an event was posted at tick `t` with a delay of `delay`
+  /// ticks.
+  void tick_event(tick_time t, tick_duration delay);
+
+private:
+  void add(tick_time t, replay_entry kind, int32_t x, int32_t y);
+
+  void flush_frame();
+
+  void write(const std::vector<uint8_t>& buf);
+
+  FILE* file_;
+
+  /// Number of bytes written so far.
+  uint64_t offset_;
+
+  /// Tick of the last written frame.
+  tick_time last_tick_;
+
+  /// Tick of the frame in `frame_`.
+  tick_time frame_tick_;
+
+  /// Encoded entries of the current frame.
+  std::vector<uint8_t> frame_;
+
+  /// Stores tick and offset of indexed frames.
+  std::vector<std::pair<tick_time, uint64_t>> index_;
+
+  /// Reusable buffer for encoding frame headers.
+  std::vector<uint8_t> buf_;
+};
+
+/// Reads a memory-mapped replay log.
+class replay_log_reader {
+public:
+  replay_log_reader();
+
+  ~replay_log_reader();
+
+  replay_log_reader(const replay_log_reader&) = delete;
+
+  replay_log_reader& operator=(const replay_log_reader&) = delete;
+
+  /// Maps the log at `path` into memory and reads its header. Rebuilds the
+  /// index if the log has none, e.g., because the recording crashed.
+  /// @returns `false` if the file is not a valid replay log, `true` otherwise.
+  bool open(const std::string& path);
+
+  /// Returns the seed of the recorded run.
+  inline uint32_t seed() const {
+    return seed_;
+  }
+
+  /// Returns the layout of the recorded run.
+  inline const std::string& layout() const {
+    return layout_;
+  }
+
+  /// Returns the tick of the last frame in the log.
+  inline tick_time last_tick() const {
+    return last_tick_;
+  }
+
+  /// Positions the reader at the first frame with a tick not less than `t`.
+  /// Looks up the closest indexed frame and skips at most a few frames.
+  void seek(tick_time t);
+
+  /// Reads the next entry, which must be a delivery to `receiver` at tick
+  /// `t`, and stores its delay in `delay`.
+  /// @returns `false` if the replay diverged from the log, `true` otherwise.
+  bool delivery(tick_time t, int32_t receiver, tick_duration& delay);
+
+  /// Reads the next entry, which must be a tick event at tick `t`, and
+  /// stores its delay in `delay`.
+  /// @returns `false` if the replay diverged from the log, `true` otherwise.
+  bool tick_event(tick_time t, tick_duration& delay);
+
+private:
+  bool next(tick_time t, replay_entry& kind, int32_t& x, int32_t& y);
+
+  /// Reads the header of the frame at `pos_` and sets `frame_tick_` to
+  /// `base` plus the encoded delta.
+  bool read_frame(tick_time base);
+
+  /// Reads all frames starting at `offset` to find the last tick and to add
+  /// missing index entries. The tick of the first frame is `t` if
+  /// `known_tick` is set, otherwise its delta is relative to tick 0.
+  void scan_frames(size_t offset, tick_time t, bool known_tick);
+
+  void unmap();
+
+  /// Start of the mapped file.
+  const uint8_t* data_;
+
+  /// Size of the mapped file.
+  size_t size_;
+
+  /// Offset of the first frame.
+  size_t first_frame_;
+
+  /// Offset past the last frame.
+  size_t frames_end_;
+
+  /// Offset of the next frame.
+  size_t pos_;
+
+  /// Offset of the next entry in the current frame.
+  size_t entry_pos_;
+
+  /// Offset past the current frame.
+  size_t frame_end_;
+
+  /// Tick of the current frame.
+  tick_time frame_tick_;
+
+  /// Tick of the last frame in the log.
+  tick_time last_tick_;
+
+  uint32_t seed_;
+
+  std::string layout_;
+
+  /// Stores tick and offset of indexed frames.
+  std::vector<std::pair<tick_time, uint64_t>> index_;
+};
+
+#endif // REPLAY_LOG_HPP
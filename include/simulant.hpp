@@ -1,9 +1,13 @@
 #ifndef SIMULANT_HPP
 #define SIMULANT_HPP
 
+#include <vector>
+#include <cstdint>
+
 #include "caf/scheduled_actor.hpp"
 
 #include "fwd.hpp"
+#include "tick_time.hpp"
 #include "simulant_tree_model.hpp"
 
 class simulant : public caf::scheduled_actor {
@@ -36,11 +40,35 @@ public:
   }
 
   inline void update_model() {
-    serialize_state(*model_.root());
+    model_.update();
+  }
+
+  /// Returns a counter that increases whenever the state of this simulant
+  /// may have changed.
+  inline uint64_t version() const {
+    return version_;
+  }
+
+  /// Marks the state of this simulant as changed.
+  inline void touch() {
+    ++version_;
+  }
+
+  /// Returns when the message in `consume` arrived in the mailbox.
+  inline tick_time received_at() const {
+    return received_at_;
   }
 
+  /// Renders the state of all streams into the tree at `root`. Rebuilds the
+  /// tree only after adding or removing streams or paths. Otherwise, pushes
+  /// only changed values into the existing items.
   void serialize_state(simulant_tree_item& root);
 
+  /// Serializes the mailbox and all stream managers to `out`. Identifies
+  /// actors by the rank of their entity, i.e., the output only depends on
+  /// the simulated state.
+  void save_state(state_writer& out);
+
   void detach_from_parent();
 
   inline entity* parent() {
@@ -86,6 +114,21 @@ private:
 
   // Protects access to `pending_messages_`.
   std::mutex pending_messages_mtx_;
+
+  // Counts changes to the state of this simulant.
+  uint64_t version_;
+
+  // Stores the receive timestamp of the message in `consume`.
+  tick_time received_at_;
+
+  // Stores whether `state_leaves_` reflects the tree of the model.
+  bool state_tree_built_;
+
+  // Stores the streams and paths at the last rebuild of the tree.
+  std::vector<const void*> state_layout_;
+
+  // Stores all leaves of the tree in serialization order.
+  std::vector<simulant_tree_item*> state_leaves_;
 };
 
 void intrusive_ptr_add_ref(simulant*);
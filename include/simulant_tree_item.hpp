@@ -4,6 +4,7 @@
 #include <memory>
 #include <vector>
 
+#include <QHash>
 #include <QString>
 #include <QVariant>
 
@@ -36,11 +37,13 @@ public:
 
   /// Returns whether a child with ID `id` exists on this item.
   inline bool has_child(const QString& id) const {
-    return index_of(id) == -1;
+    return children_index_.contains(id);
   }
 
   /// Returns the row of this item relative to its parent.
-  int index_at_parent() const;
+  inline int index_at_parent() const {
+    return parent_ != nullptr ? parent_->row_of(row_) : 0;
+  }
 
   /// Returns the rendering data at column `x`.
   QVariant data(int x) const;
@@ -87,8 +90,10 @@ public:
   template <class F>
   void for_all_children(F& f) {
     for (auto& child : children_) {
-      f(*child);
-      child->for_all_children(f);
+      if (child) {
+        f(*child);
+        child->for_all_children(f);
+      }
     }
   }
 
@@ -100,6 +105,9 @@ public:
     value_ = std::move(x);
   }
 
+  /// Sets the value and notifies the model if the value changed.
+  void update_value(QVariant x);
+
   QModelIndex index(int column = 0);
 
   inline bool stale() const {
@@ -109,15 +117,38 @@ public:
   /// Marks this item and all of its children as stale until it gets updated.
   void mark_as_stale();
 
-  /// Removes all stale children.
+  /// Removes all stale children recursively in a single pass.
   void purge();
 
 private:
+  /// Translates a position in `children_` to a row.
+  inline int row_of(size_t pos) const {
+    return static_cast<int>(pos < gap_pos_ ? pos : pos - gap_size_);
+  }
+
+  /// Translates a row to a position in `children_`.
+  inline size_t pos_of(int row) const {
+    auto pos = static_cast<size_t>(row);
+    return pos < gap_pos_ ? pos : pos + gap_size_;
+  }
+
   simulant_tree_model* model_;
   simulant_tree_item* parent_;
   QString id_;
   QVariant value_;
   children_vec children_;
+
+  /// Maps IDs to children.
+  QHash<QString, simulant_tree_item*> children_index_;
+
+  /// Position of this item in `children_` of its parent.
+  size_t row_;
+
+  /// While purging, `children_` contains a range of removed children that
+  /// starts at `gap_pos_` and spans `gap_size_` elements.
+  size_t gap_pos_;
+  size_t gap_size_;
+
   bool stale_;
 };
 
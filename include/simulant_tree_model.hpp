@@ -2,6 +2,7 @@
 #define SIMULANT_TREE_MODEL_HPP
 
 #include <memory>
+#include <cstdint>
 
 #include <QAbstractItemModel>
 
@@ -36,14 +37,32 @@ public:
     return &root_;
   }
 
-  /// Updates the model.
+  /// Serializes the state of the simulant into the tree if at least one view
+  /// shows this model and the state changed since the last update.
   void update();
 
+  /// Registers a view that shows this model and brings the tree up to date.
+  void add_observer();
+
+  /// Unregisters a view that no longer shows this model.
+  void remove_observer();
+
+  /// Returns whether at least one view shows this model.
+  inline bool observed() const {
+    return observers_ > 0;
+  }
+
 private:
   simulant_tree_item* ptr(const QModelIndex& x) const;
 
   simulant* parent_;
   mutable simulant_tree_item root_;
+
+  /// Number of views that show this model.
+  int observers_;
+
+  /// Version of the simulant state that the tree reflects.
+  uint64_t version_;
 };
 
 #endif // SIMULANT_TREE_MODEL_HPP
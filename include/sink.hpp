@@ -22,11 +22,6 @@
 
 #include <cstdint>
 
-#include <QSpinBox>
-#include <QLabel>
-#include <QListWidget>
-#include <QProgressBar>
-
 #include "caf/stream_manager.hpp"
 
 #include "entity.hpp"
@@ -41,6 +36,8 @@ public:
   void start() override;
 
 private:
+  caf::inbound_path* last_batch_path_;
+  tick_time last_batch_received_;
   tick_time last_batch_start_;
   caf::stream_manager_ptr smp;
 };
@@ -20,11 +20,9 @@
 #ifndef SOURCE_HPP
 #define SOURCE_HPP
 
-#include <QSpinBox>
-#include <QProgressBar>
+#include <vector>
 
 #include "entity.hpp"
-#include "mainwindow.hpp"
 
 class source : virtual public entity {
 public:
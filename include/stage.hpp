@@ -20,8 +20,11 @@
 #ifndef STAGE_HPP
 #define STAGE_HPP
 
+#include "caf/fwd.hpp"
+
 #include "sink.hpp"
 #include "source.hpp"
+#include "tick_time.hpp"
 
 class stage : public source, public sink {
   public:
@@ -33,6 +36,15 @@ class stage : public source, public sink {
 
 private:
   int completed_items_;
+
+  /// Inbound path of the current batch.
+  caf::inbound_path* batch_path_;
+
+  /// Receive timestamp of the current batch.
+  tick_time batch_received_;
+
+  /// Start of processing the current batch.
+  tick_time batch_start_;
 };
 
 #endif // STAGE_HPP
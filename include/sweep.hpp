@@ -0,0 +1,106 @@
+#ifndef SWEEP_HPP
+#define SWEEP_HPP
+
+#include <string>
+#include <vector>
+#include <cstdio>
+
+#include "environment.hpp"
+
+/// Runs a headless simulation for each point of a parameter grid and each
+/// seed on a pool of worker threads. Each run has its own `environment`,
+/// i.e., its own actor system, and runs to completion on a single worker.
+class sweep {
+public:
+  // -- Nested types -----------------------------------------------------------
+
+  /// A parameter and all of its values in the grid.
+  struct axis {
+    std::string name;
+    std::vector<std::string> values;
+  };
+
+  /// Mean, standard deviation and half-width of the 95% confidence interval
+  /// of a metric across all seeds.
+  struct estimate {
+    double mean = 0;
+    double stddev = 0;
+    double ci95 = 0;
+  };
+
+  /// Aggregated results for a single point of the grid.
+  struct row {
+    /// Values for each axis.
+    std::vector<std::string> params;
+
+    /// Number of successful runs.
+    size_t runs = 0;
+
+    estimate throughput;
+    estimate avg_latency;
+    estimate p50;
+    estimate p99;
+    estimate p999;
+    estimate idle;
+    estimate credit_oscillation;
+  };
+
+  // -- Construction -----------------------------------------------------------
+
+  /// @param args CLI arguments for the simulation, where `args[0]` is the
+  ///        program name. Any sweep, trace and replay options as well as
+  ///        options for parameters in `grid` are ignored.
+  /// @param grid Parameters to vary.
+  /// @param seeds Number of seeds per point of the grid.
+  /// @param threads Number of worker threads or 0 for one per core.
+  sweep(const std::vector<std::string>& args, std::vector<axis> grid,
+        int seeds, int threads);
+
+  // -- Properties -------------------------------------------------------------
+
+  inline const std::vector<axis>& grid() const {
+    return grid_;
+  }
+
+  inline const std::vector<row>& rows() const {
+    return rows_;
+  }
+
+  // -- Running and reporting --------------------------------------------------
+
+  /// Parses a grid such as "cycle-duration=50,100;min-tokens=10,100".
+  /// @returns `false` and stores an error message in `err` on failure.
+  static bool parse_grid(const std::string& str, std::vector<axis>& result,
+                         std::string& err);
+
+  /// Runs all simulations and aggregates their results.
+  void run();
+
+  /// Writes the aggregated results as JSON if `path` ends in ".json" and as
+  /// CSV otherwise.
+  /// @returns `false` if the file cannot be written, `true` otherwise.
+  bool write_report(const std::string& path) const;
+
+private:
+  /// Returns the CLI arguments for point `point` of the grid and `seed`.
+  std::vector<std::string> args_for(size_t point, int seed) const;
+
+  /// Returns the number of points in the grid.
+  size_t num_points() const;
+
+  void write_csv(FILE* f) const;
+
+  void write_json(FILE* f) const;
+
+  std::vector<std::string> base_args_;
+
+  std::vector<axis> grid_;
+
+  int seeds_;
+
+  int threads_;
+
+  std::vector<row> rows_;
+};
+
+#endif // SWEEP_HPP
@@ -1,11 +1,16 @@
 #ifndef TERM_GATHERER_HPP
 #define TERM_GATHERER_HPP
 
+#include <memory>
+#include <vector>
+
 #include "caf/fwd.hpp"
 #include "caf/random_gatherer.hpp"
 
 #include "fwd.hpp"
 #include "tick_time.hpp"
+#include "batch_tuner.hpp"
+#include "credit_policy.hpp"
 #include "rate_controlled_source.hpp"
 
 class term_gatherer : public caf::random_gatherer,
@@ -17,7 +22,7 @@ public:
   term_gatherer(caf::local_actor* self, Scatterer& out)
       : super(self, out),
         parent_(static_cast<simulant*>(self)->parent()) {
-    // nop
+    init();
   }
 
   term_gatherer() = delete;
@@ -30,15 +35,28 @@ public:
 
   long initial_credit(long downstream_capacity, path_ptr x) override;
 
-  void batch_completed(long xs_size, tick_time enqueue_time,
-                       tick_time start_time, tick_time end_time) override;
+  bool remove_path(const caf::stream_id& sid, const caf::actor_addr& x,
+                   caf::error reason, bool silent) override;
+
+  /// Returns whether `x` is an open inbound path of this gatherer.
+  bool contains(caf::inbound_path* x) const;
+
+  void batch_completed(caf::inbound_path* from, long xs_size,
+                       tick_time enqueue_time, tick_time start_time,
+                       tick_time end_time) override;
 
   long generate_tokens(tick_time now) override;
 
+  /// Serializes the configuration and controller state to `out`.
+  void save_state(state_writer& out) const;
+
   entity* parent_;
 
   // -- static configuration
 
+  /// Loads the static configuration from the environment.
+  void init();
+
   double proportional_ = 1;
   double integral_ = .2;
   double derivative_ = 0;
@@ -50,10 +68,23 @@ public:
   /// The desired processing time for a single batch in ticks.
   tick_duration desired_batch_complexity_ = 20;
 
+  /// The desired time a batch waits in the mailbox in ticks.
+  tick_duration target_queueing_delay_ = 20;
+
   /// Minimum number of items per batch even if this puts the complexity above
   /// `desired_batch_complexity_`.
   long min_batch_size = 5;
 
+  /// Hands credit that slow paths leave unused to backlogged paths.
+  bool max_min_fairness_ = false;
+
+  /// Computes the number of tokens per cycle.
+  credit_policy_ptr policy_;
+
+  /// Tunes batch sizes and the cycle duration for a latency target or
+  /// `nullptr` if no target is configured.
+  std::unique_ptr<batch_tuner> tuner_;
+
   // -- dynamic configuration
 
   long batch_size_hint = 50;
@@ -77,11 +108,52 @@ public:
   /// Number of processed items in the last cycle.
   long processed_items_ = 0;
 
+  /// Number of completed batches in the last cycle.
+  long completed_batches_ = 0;
+
+  /// Time batches waited in the mailbox during the last cycle.
+  tick_duration queueing_time_ = 0;
+
   // -- timeout management
 
   int64_t cycle_timeout = 0;
 
   void set_cycle_timeout();
+
+private:
+  /// Credit split for a single inbound path.
+  struct path_share {
+    caf::inbound_path* path;
+
+    /// Entity at the other end of the path or `nullptr`.
+    entity* upstream;
+
+    /// Credit of the path after the last assignment.
+    long target;
+
+    /// Weight for the current assignment.
+    double weight;
+
+    /// Credit the path can use during the current assignment.
+    double demand;
+  };
+
+  /// Adds shares for new paths and drops shares for closed paths. Keeps the
+  /// order of `assignment_vec_`.
+  void sync_shares();
+
+  /// Returns a fresh share for `x` with the upstream entity looked up.
+  path_share make_share(caf::inbound_path* x) const;
+
+  /// Returns the source weight of the upstream entity, scaled by the stream
+  /// priority of the path.
+  static double weight_of(const path_share& x);
+
+  /// Stores one share per path in `assignment_vec_`.
+  std::vector<path_share> shares_;
+
+  /// Stores indexes into `shares_` in water-filling order.
+  std::vector<size_t> order_;
 };
 
 #endif // TERM_GATHERER_HPP
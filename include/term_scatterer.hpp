@@ -20,15 +20,7 @@ public:
     // nop
   }
 
-  void batch_sent(tick_time tstamp, size_t num_elements) override;
-
-  double last_rate(tick_time tstamp) override;
-
 private:
-  using sample = std::pair<tick_time, size_t>;
-
-  std::vector<sample> samples_;
-
   struct rate_state {
   };
 
@@ -0,0 +1,237 @@
+#ifndef TIMING_WHEEL_HPP
+#define TIMING_WHEEL_HPP
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "tick_time.hpp"
+
+/// A hierarchical timing wheel that stores values of type `T` by timestamp.
+/// The wheel consists of four levels with 256 slots each, i.e., one level per
+/// byte of a `tick_time`. A value with timestamp `t` resides on the level of
+/// the most significant byte in which `t` differs from the current time.
+/// Inserting a value and draining the slot of the current tick are O(1),
+/// values only move to a lower level once when the wheel crosses the boundary
+/// of their slot. Slots keep their capacity, i.e., the wheel stops allocating
+/// memory once it reached its working set.
+template <class T>
+class timing_wheel {
+public:
+  // -- Nested types -----------------------------------------------------------
+
+  using value_type = std::pair<tick_time, T>;
+
+  using slot_type = std::vector<value_type>;
+
+  // -- Constants --------------------------------------------------------------
+
+  static constexpr size_t num_levels = 4;
+
+  static constexpr size_t slot_bits = 8;
+
+  static constexpr size_t num_slots = size_t{1} << slot_bits;
+
+  // -- Construction -----------------------------------------------------------
+
+  timing_wheel() : now_(0), size_(0) {
+    for (auto& lvl : levels_)
+      lvl.bitmap.fill(0);
+  }
+
+  timing_wheel(const timing_wheel&) = delete;
+
+  timing_wheel& operator=(const timing_wheel&) = delete;
+
+  // -- Properties -------------------------------------------------------------
+
+  /// Returns the number of stored values.
+  inline size_t size() const {
+    return size_;
+  }
+
+  /// Returns whether the wheel contains no values.
+  inline bool empty() const {
+    return size_ == 0;
+  }
+
+  /// Returns the earliest timestamp that was not drained yet.
+  inline tick_time now() const {
+    return now_;
+  }
+
+  /// Returns the timestamp of the earliest value or the maximum `tick_time`
+  /// if the wheel is empty.
+  tick_time next_timestamp() const {
+    if (empty())
+      return std::numeric_limits<tick_time>::max();
+    for (size_t k = 0; k < num_levels; ++k) {
+      auto& lvl = levels_[k];
+      auto i = first_set(lvl.bitmap);
+      if (i == num_slots)
+        continue;
+      // Lower levels always store earlier values. On level 0, all values in
+      // a slot share the same timestamp.
+      auto& slot = lvl.slots[i];
+      if (k == 0)
+        return slot.front().first;
+      auto result = slot.front().first;
+      for (auto& x : slot)
+        if (x.first < result)
+          result = x.first;
+      return result;
+    }
+    return std::numeric_limits<tick_time>::max();
+  }
+
+  // -- Modifiers --------------------------------------------------------------
+
+  /// Inserts `x` with timestamp `t`. Values with a timestamp in the past are
+  /// due on the next call to `drain`.
+  void push(tick_time t, T x) {
+    if (t < now_)
+      t = now_;
+    place(value_type{t, std::move(x)});
+    ++size_;
+  }
+
+  /// Calls `f(t, x)` for all values with a timestamp `t <= until`, ordered by
+  /// timestamp, and removes them from the wheel. Afterwards, `now()` returns
+  /// `until + 1`.
+  /// @warning `f` must not modify the wheel.
+  template <class F>
+  void drain(tick_time until, F f) {
+    while (!empty()) {
+      auto t = next_timestamp();
+      if (t > until)
+        break;
+      move_to(t);
+      auto& lvl = levels_[0];
+      auto i = index(t, 0);
+      using std::swap;
+      swap(lvl.slots[i], buf_);
+      unset(lvl.bitmap, i);
+      size_ -= buf_.size();
+      for (auto& x : buf_)
+        f(x.first, x.second);
+      buf_.clear();
+    }
+    if (until >= now_)
+      move_to(until + 1);
+  }
+
+  /// Calls `f(t, x)` for all stored values in unspecified order.
+  template <class F>
+  void for_each(F f) const {
+    for (auto& lvl : levels_)
+      for (auto& slot : lvl.slots)
+        for (auto& x : slot)
+          f(x.first, x.second);
+  }
+
+  /// Removes all values and resets the current time to `t`.
+  void reset(tick_time t = 0) {
+    for (auto& lvl : levels_) {
+      for (auto& slot : lvl.slots)
+        slot.clear();
+      lvl.bitmap.fill(0);
+    }
+    now_ = t;
+    size_ = 0;
+  }
+
+private:
+  // -- Nested types -----------------------------------------------------------
+
+  using bitmap_type = std::array<uint64_t, num_slots / 64>;
+
+  struct level {
+    std::array<slot_type, num_slots> slots;
+    bitmap_type bitmap;
+  };
+
+  // -- Bit fiddling -----------------------------------------------------------
+
+  static inline uint32_t bits(tick_time x) {
+    return static_cast<uint32_t>(x);
+  }
+
+  static inline size_t index(tick_time t, size_t lvl) {
+    return (bits(t) >> (lvl * slot_bits)) & (num_slots - 1);
+  }
+
+  // Returns the level for timestamp `t`, i.e., the most significant byte
+  // in which `t` differs from `now_`.
+  inline size_t level_of(tick_time t) const {
+    auto diff = bits(t) ^ bits(now_);
+    size_t result = 0;
+    while ((diff >>= slot_bits) != 0)
+      ++result;
+    return result;
+  }
+
+  static inline void set(bitmap_type& xs, size_t i) {
+    xs[i / 64] |= uint64_t{1} << (i % 64);
+  }
+
+  static inline void unset(bitmap_type& xs, size_t i) {
+    xs[i / 64] &= ~(uint64_t{1} << (i % 64));
+  }
+
+  // Returns the index of the first set bit or `num_slots`.
+  static inline size_t first_set(const bitmap_type& xs) {
+    for (size_t i = 0; i < xs.size(); ++i)
+      if (xs[i] != 0)
+        return i * 64 + static_cast<size_t>(__builtin_ctzll(xs[i]));
+    return num_slots;
+  }
+
+  // -- Slot management --------------------------------------------------------
+
+  void place(value_type x) {
+    auto k = level_of(x.first);
+    auto i = index(x.first, k);
+    auto& lvl = levels_[k];
+    lvl.slots[i].emplace_back(std::move(x));
+    set(lvl.bitmap, i);
+  }
+
+  // Advances the current time to `t`.
+  // @pre No value has a timestamp less than `t`.
+  void move_to(tick_time t) {
+    auto k = level_of(t);
+    now_ = t;
+    if (k == 0)
+      return;
+    // Crossing a boundary on level k only affects the slot we have entered.
+    // All values in it move to a lower level.
+    auto& lvl = levels_[k];
+    auto i = index(t, k);
+    if (lvl.slots[i].empty())
+      return;
+    slot_type xs;
+    using std::swap;
+    swap(xs, lvl.slots[i]);
+    unset(lvl.bitmap, i);
+    for (auto& x : xs)
+      place(std::move(x));
+  }
+
+  // -- Member variables -------------------------------------------------------
+
+  /// Earliest timestamp that was not drained yet.
+  tick_time now_;
+
+  /// Number of stored values.
+  size_t size_;
+
+  /// Stores all values, indexed by level.
+  std::array<level, num_levels> levels_;
+
+  /// Reusable buffer for draining a slot.
+  slot_type buf_;
+};
+
+#endif // TIMING_WHEEL_HPP
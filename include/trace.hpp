@@ -0,0 +1,136 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "tick_time.hpp"
+
+// -- Trace levels -------------------------------------------------------------
+
+/// Disables all tracing at compile time.
+#define TRACE_LEVEL_NONE 0
+
+/// Traces decisions of credit controllers.
+#define TRACE_LEVEL_INFO 1
+
+/// Additionally traces every message and idle tick.
+#define TRACE_LEVEL_DEBUG 2
+
+#ifndef TRACE_LEVEL
+#define TRACE_LEVEL TRACE_LEVEL_DEBUG
+#endif
+
+// -- Trace records ------------------------------------------------------------
+
+/// Identifies the type of a trace record.
+enum class trace_event : uint16_t {
+  /// Associates an entity rank with up to 24 characters of its name.
+  entity_name,
+  /// args: number of idle ticks
+  sink_idling,
+  /// args: message ID, type token of the content
+  message_received,
+  /// args: message ID
+  message_consumed,
+  /// args: available credit
+  assign_credit,
+  /// args: number of items, start time, end time
+  batch_completed,
+  /// args: last token count (double), processed items, last cycle
+  generate_tokens,
+  /// args: time per item (double)
+  time_per_item,
+  /// args: upper bound for tokens (double)
+  upper_bound
+};
+
+/// Returns a human-readable name for `x`.
+const char* to_string(trace_event x);
+
+/// A fixed-size, binary trace record.
+struct trace_record {
+  trace_event event;
+  uint16_t reserved1;
+  tick_time time;
+  int32_t entity;
+  uint32_t reserved2;
+  uint64_t args[3];
+};
+
+static_assert(sizeof(trace_record) == 40, "unexpected padding in trace_record");
+
+/// Magic bytes at the beginning of each trace file.
+constexpr char trace_file_magic[8] = {'S', 'S', 'T', 'R', 'A', 'C', 'E', '1'};
+
+// -- Argument encoding --------------------------------------------------------
+
+template <class T>
+std::enable_if_t<std::is_integral<T>::value, uint64_t> trace_arg(T x) {
+  return static_cast<uint64_t>(static_cast<int64_t>(x));
+}
+
+inline uint64_t trace_arg(double x) {
+  uint64_t result;
+  memcpy(&result, &x, sizeof(double));
+  return result;
+}
+
+inline int64_t trace_int(uint64_t x) {
+  return static_cast<int64_t>(x);
+}
+
+inline double trace_double(uint64_t x) {
+  double result;
+  memcpy(&result, &x, sizeof(double));
+  return result;
+}
+
+// -- Trace sink ---------------------------------------------------------------
+
+/// Stores whether a trace file is open. Only accessed via `trace_enabled()`.
+extern std::atomic<bool> trace_active;
+
+/// Returns whether a trace file is open.
+inline bool trace_enabled() {
+  return trace_active.load(std::memory_order_relaxed);
+}
+
+/// Starts writing trace records to `path`.
+/// @returns `false` if the file could not be opened, `true` otherwise.
+bool trace_open(const std::string& path);
+
+/// Flushes all pending trace records and closes the trace file.
+void trace_close();
+
+/// Adds `x` to the trace buffer of the calling thread without locking.
+void trace_push(const trace_record& x);
+
+/// Creates and pushes a new trace record.
+template <class... Ts>
+void trace_emit(trace_event event, int32_t entity, tick_time t, Ts... xs) {
+  static_assert(sizeof...(Ts) <= 3, "too many arguments for trace record");
+  trace_push(trace_record{event, 0, t, entity, 0, {trace_arg(xs)...}});
+}
+
+/// Associates `entity` with `name` in the trace.
+void trace_name(int32_t entity, const std::string& name);
+
+// -- Convenience macros -------------------------------------------------------
+
+/// Emits a trace record if `level` is enabled at compile time and a trace
+/// file is open. Arguments are not evaluated otherwise.
+#define TRACE(level, ...)                                                      \
+  do {                                                                         \
+    if (level <= TRACE_LEVEL && trace_enabled())                               \
+      trace_emit(__VA_ARGS__);                                                 \
+  } while (false)
+
+#define TRACE_INFO(...) TRACE(TRACE_LEVEL_INFO, __VA_ARGS__)
+
+#define TRACE_DEBUG(...) TRACE(TRACE_LEVEL_DEBUG, __VA_ARGS__)
+
+#endif // TRACE_HPP
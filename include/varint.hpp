@@ -0,0 +1,43 @@
+#ifndef VARINT_HPP
+#define VARINT_HPP
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+/// Appends `x` to `buf` using 7 bits per byte, i.e., small values occupy a
+/// single byte.
+inline void put_varint(std::vector<uint8_t>& buf, uint64_t x) {
+  while (x > 0x7f) {
+    buf.emplace_back(static_cast<uint8_t>(x & 0x7f) | 0x80);
+    x >>= 7;
+  }
+  buf.emplace_back(static_cast<uint8_t>(x));
+}
+
+/// Reads a varint at `data[pos]` into `x` and advances `pos`.
+/// @returns `false` if `data` ends before the varint, `true` otherwise.
+inline bool get_varint(const uint8_t* data, size_t size, size_t& pos,
+                       uint64_t& x) {
+  x = 0;
+  for (unsigned shift = 0; shift < 64 && pos < size; shift += 7) {
+    auto byte = data[pos++];
+    x |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0)
+      return true;
+  }
+  return false;
+}
+
+/// Maps signed integers to unsigned integers with small absolute values
+/// mapping to small numbers, e.g., -1 to 1 and 1 to 2.
+inline uint64_t zigzag(int64_t x) {
+  return (static_cast<uint64_t>(x) << 1) ^ static_cast<uint64_t>(x >> 63);
+}
+
+/// Reverses `zigzag`.
+inline int64_t unzigzag(uint64_t x) {
+  return static_cast<int64_t>((x >> 1) ^ (~(x & 1) + 1));
+}
+
+#endif // VARINT_HPP
@@ -0,0 +1,135 @@
+#include "batch_tuner.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+constexpr size_t batch_tuner::max_decisions;
+
+namespace {
+
+// Weight of the latest sample in the smoothed time per item.
+constexpr double smoothing = .3;
+
+// Factor for growing batch sizes, shrinking uses the inverse.
+constexpr double step = 1.25;
+
+// Tolerates this relative throughput drop before changing direction.
+constexpr double tolerance = .02;
+
+// Lower bound for the cycle duration.
+constexpr tick_duration min_cycle_duration = 10;
+
+} // namespace <anonymous>
+
+batch_tuner::batch_tuner(tick_duration target, long min_batch_size,
+                         tick_duration cycle_duration)
+    : target_(target),
+      min_batch_size_(std::max(min_batch_size, 1l)),
+      cycle_duration_(cycle_duration) {
+  // nop
+}
+
+void batch_tuner::add_path(const void* key, std::string name,
+                           long batch_size) {
+  paths_.emplace(key, path_state{std::move(name),
+                                 std::max(batch_size, min_batch_size_), 0., 0.,
+                                 1, 0, 0, 0});
+}
+
+void batch_tuner::remove_path(const void* key) {
+  paths_.erase(key);
+}
+
+void batch_tuner::record(const void* key, long xs_size, tick_duration latency,
+                         tick_duration processing_time) {
+  auto i = paths_.find(key);
+  if (i == paths_.end())
+    return;
+  auto& x = i->second;
+  x.items += xs_size;
+  x.processing_time += processing_time;
+  x.max_latency = std::max(x.max_latency, latency);
+}
+
+void batch_tuner::end_cycle(tick_time now, tick_duration duration) {
+  if (duration <= 0)
+    return;
+  tick_duration worst = 0;
+  tick_duration longest_batch = 0;
+  for (auto& kvp : paths_) {
+    auto& x = kvp.second;
+    worst = std::max(worst, tune(x, now, duration));
+    longest_batch = std::max(longest_batch, static_cast<tick_duration>(
+                               std::ceil(x.batch_size * x.time_per_item)));
+  }
+  // Shorter cycles react faster to congestion, longer cycles grant credit in
+  // larger chunks. A cycle should cover at least one batch.
+  auto old = cycle_duration_;
+  if (worst > target_)
+    cycle_duration_ = static_cast<tick_duration>(cycle_duration_ / step);
+  else if (worst > 0 && worst < target_ / 2)
+    cycle_duration_ = static_cast<tick_duration>(std::ceil(cycle_duration_
+                                                           * step));
+  cycle_duration_ = std::max({std::min(cycle_duration_, target_),
+                              min_cycle_duration, longest_batch});
+  if (cycle_duration_ != old)
+    log(now, "cycle " + std::to_string(old) + " -> "
+               + std::to_string(cycle_duration_) + " (worst latency "
+               + std::to_string(worst) + ")");
+}
+
+long batch_tuner::batch_size(const void* key) const {
+  auto i = paths_.find(key);
+  return i != paths_.end() ? i->second.batch_size : 0;
+}
+
+tick_duration batch_tuner::tune(path_state& x, tick_time now,
+                                tick_duration duration) {
+  auto latency = x.max_latency;
+  auto items = x.items;
+  auto processing_time = x.processing_time;
+  x.items = 0;
+  x.processing_time = 0;
+  x.max_latency = 0;
+  if (items == 0)
+    return latency;
+  auto sample = static_cast<double>(processing_time) / items;
+  x.time_per_item = x.time_per_item > 0
+                    ? smoothing * sample + (1 - smoothing) * x.time_per_item
+                    : sample;
+  auto throughput = static_cast<double>(items) / duration;
+  auto old = x.batch_size;
+  const char* reason;
+  if (latency > target_) {
+    x.batch_size /= 2;
+    x.direction = -1;
+    reason = "missed target";
+  } else {
+    if (throughput < x.last_throughput * (1 - tolerance)) {
+      x.direction = -x.direction;
+      reason = "throughput dropped";
+    } else {
+      reason = "throughput held";
+    }
+    auto next = x.direction > 0 ? std::ceil(x.batch_size * step)
+                                : std::floor(x.batch_size / step);
+    x.batch_size = static_cast<long>(next);
+  }
+  x.last_throughput = throughput;
+  // Processing a single batch may take up to half the target.
+  auto cap = x.time_per_item > 0
+             ? static_cast<long>(target_ / (2 * x.time_per_item))
+             : x.batch_size;
+  x.batch_size = std::max(std::min(x.batch_size, cap), min_batch_size_);
+  if (x.batch_size != old)
+    log(now, x.name + ": batch " + std::to_string(old) + " -> "
+               + std::to_string(x.batch_size) + " (" + reason + ", latency "
+               + std::to_string(latency) + ")");
+  return latency;
+}
+
+void batch_tuner::log(tick_time now, std::string what) {
+  if (decisions_.size() == max_decisions)
+    decisions_.pop_front();
+  decisions_.emplace_back("t=" + std::to_string(now) + " " + what);
+}
@@ -0,0 +1,156 @@
+#include "checkpoint.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#include "varint.hpp"
+
+namespace {
+
+constexpr char checkpoint_magic[] = "SSCHKPT1";
+
+constexpr size_t magic_size = sizeof(checkpoint_magic) - 1;
+
+constexpr uint64_t format_version = 2;
+
+void put_bytes(std::vector<uint8_t>& buf, const uint8_t* data, size_t size) {
+  put_varint(buf, size);
+  buf.insert(buf.end(), data, data + size);
+}
+
+bool get_bytes(const std::vector<uint8_t>& buf, size_t& pos,
+               std::vector<uint8_t>& x) {
+  uint64_t size;
+  if (!get_varint(buf.data(), buf.size(), pos, size)
+      || size > buf.size() - pos)
+    return false;
+  x.assign(buf.begin() + pos, buf.begin() + pos + size);
+  pos += size;
+  return true;
+}
+
+bool get_int(const std::vector<uint8_t>& buf, size_t& pos, int64_t& x) {
+  uint64_t tmp;
+  if (!get_varint(buf.data(), buf.size(), pos, tmp))
+    return false;
+  x = unzigzag(tmp);
+  return true;
+}
+
+} // namespace <anonymous>
+
+// -- state_writer -------------------------------------------------------------
+
+void state_writer::put(double x) {
+  uint64_t tmp;
+  memcpy(&tmp, &x, sizeof(double));
+  for (size_t i = 0; i < sizeof(uint64_t); ++i)
+    buf_.emplace_back(static_cast<uint8_t>(tmp >> (i * 8)));
+}
+
+void state_writer::put(const std::string& x) {
+  put_bytes(buf_, reinterpret_cast<const uint8_t*>(x.data()), x.size());
+}
+
+void state_writer::put_int(int64_t x) {
+  put_varint(buf_, zigzag(x));
+}
+
+// -- state_reader -------------------------------------------------------------
+
+state_reader::state_reader(const std::vector<uint8_t>& buf)
+    : buf_(buf),
+      pos_(0) {
+  // nop
+}
+
+bool state_reader::get_int(int64_t& x) {
+  return ::get_int(buf_, pos_, x);
+}
+
+// -- checkpoint ---------------------------------------------------------------
+
+bool checkpoint::save(const std::string& path) const {
+  std::vector<uint8_t> buf{checkpoint_magic, checkpoint_magic + magic_size};
+  put_varint(buf, format_version);
+  put_varint(buf, seed);
+  put_bytes(buf, reinterpret_cast<const uint8_t*>(layout.data()),
+            layout.size());
+  put_varint(buf, zigzag(time));
+  put_varint(buf, zigzag(min_delay));
+  put_varint(buf, zigzag(max_delay));
+  put_varint(buf, sections.size());
+  for (auto& x : sections) {
+    put_bytes(buf, reinterpret_cast<const uint8_t*>(x.first.data()),
+              x.first.size());
+    put_bytes(buf, x.second.data(), x.second.size());
+  }
+  auto f = fopen(path.c_str(), "wb");
+  if (f == nullptr)
+    return false;
+  auto ok = fwrite(buf.data(), 1, buf.size(), f) == buf.size();
+  return fclose(f) == 0 && ok;
+}
+
+bool checkpoint::load(const std::string& path) {
+  auto f = fopen(path.c_str(), "rb");
+  if (f == nullptr)
+    return false;
+  std::vector<uint8_t> buf;
+  uint8_t chunk[4096];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+    buf.insert(buf.end(), chunk, chunk + n);
+  fclose(f);
+  if (buf.size() < magic_size
+      || memcmp(buf.data(), checkpoint_magic, magic_size) != 0)
+    return false;
+  size_t pos = magic_size;
+  uint64_t version;
+  uint64_t seed_val;
+  uint64_t num_sections;
+  int64_t time_val;
+  int64_t min_delay_val;
+  int64_t max_delay_val;
+  std::vector<uint8_t> bytes;
+  if (!get_varint(buf.data(), buf.size(), pos, version)
+      || version != format_version
+      || !get_varint(buf.data(), buf.size(), pos, seed_val)
+      || !get_bytes(buf, pos, bytes))
+    return false;
+  layout.assign(bytes.begin(), bytes.end());
+  if (!get_int(buf, pos, time_val) || !get_int(buf, pos, min_delay_val)
+      || !get_int(buf, pos, max_delay_val)
+      || !get_varint(buf.data(), buf.size(), pos, num_sections))
+    return false;
+  seed = static_cast<uint32_t>(seed_val);
+  time = static_cast<tick_time>(time_val);
+  min_delay = static_cast<tick_duration>(min_delay_val);
+  max_delay = static_cast<tick_duration>(max_delay_val);
+  sections.clear();
+  for (uint64_t i = 0; i < num_sections; ++i) {
+    section x;
+    if (!get_bytes(buf, pos, bytes) || !get_bytes(buf, pos, x.second))
+      return false;
+    x.first.assign(bytes.begin(), bytes.end());
+    sections.emplace_back(std::move(x));
+  }
+  return true;
+}
+
+std::string checkpoint::first_difference(const checkpoint& other) const {
+  auto n = std::min(sections.size(), other.sections.size());
+  for (size_t i = 0; i < n; ++i)
+    if (sections[i] != other.sections[i])
+      return sections[i].first;
+  if (sections.size() != other.sections.size())
+    return n < sections.size() ? sections[n].first : other.sections[n].first;
+  return {};
+}
+
+const std::vector<uint8_t>* checkpoint::find(const std::string& name) const {
+  auto pred = [&](const section& x) { return x.first == name; };
+  auto i = std::find_if(sections.begin(), sections.end(), pred);
+  return i != sections.end() ? &i->second : nullptr;
+}
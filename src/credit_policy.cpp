@@ -0,0 +1,166 @@
+#include "credit_policy.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+#include "checkpoint.hpp"
+
+namespace {
+
+/// Returns the average queueing delay per batch in `x` or 0 for no batches.
+double queueing_delay(const credit_cycle& x) {
+  return x.batches > 0 ? static_cast<double>(x.queueing_time) / x.batches : 0.;
+}
+
+class cycle_policy : public credit_policy {
+public:
+  explicit cycle_policy(const credit_policy_params& params)
+      : min_tokens_(params.min_tokens),
+        tokens_(params.min_tokens) {
+    // nop
+  }
+
+  const char* name() const override {
+    return "cycle";
+  }
+
+  long generate_tokens(const credit_cycle& x) override {
+    // Stick to the last token count if no batch was processed.
+    if (x.capacity > 0)
+      tokens_ = std::max(x.capacity, min_tokens_);
+    return static_cast<long>(tokens_);
+  }
+
+  void save_state(state_writer& out) const override {
+    out.put(tokens_);
+  }
+
+private:
+  double min_tokens_;
+  double tokens_;
+};
+
+class pid_policy : public credit_policy {
+public:
+  explicit pid_policy(const credit_policy_params& params)
+      : params_(params),
+        tokens_(params.min_tokens),
+        integral_(0),
+        last_err_(0) {
+    // nop
+  }
+
+  const char* name() const override {
+    return "pid";
+  }
+
+  long generate_tokens(const credit_cycle& x) override {
+    if (x.capacity <= 0 || x.time_per_item <= 0)
+      return static_cast<long>(tokens_);
+    // A positive error means batches wait less than desired, i.e., the sink
+    // can take more items. In ticks.
+    auto err = params_.target_delay - queueing_delay(x);
+    auto d_err = err - last_err_;
+    last_err_ = err;
+    // Convert the correction from ticks to items.
+    auto correction = (params_.proportional * err
+                       + params_.integral * (integral_ + err)
+                       + params_.derivative * d_err)
+                      / x.time_per_item;
+    auto tokens = x.capacity + correction;
+    // Stop integrating while the output saturates to avoid windup.
+    if (tokens >= params_.min_tokens)
+      integral_ += err;
+    tokens_ = std::max(tokens, params_.min_tokens);
+    return static_cast<long>(tokens_);
+  }
+
+  void save_state(state_writer& out) const override {
+    out.put(tokens_);
+    out.put(integral_);
+    out.put(last_err_);
+  }
+
+private:
+  credit_policy_params params_;
+  double tokens_;
+  double integral_;
+  double last_err_;
+};
+
+class aimd_policy : public credit_policy {
+public:
+  explicit aimd_policy(const credit_policy_params& params)
+      : params_(params),
+        window_(params.min_tokens) {
+    // nop
+  }
+
+  const char* name() const override {
+    return "aimd";
+  }
+
+  long generate_tokens(const credit_cycle& x) override {
+    if (x.batches > 0 && queueing_delay(x) > params_.target_delay)
+      window_ = std::max(window_ * params_.decrease, params_.min_tokens);
+    else if (x.processed_items > 0)
+      window_ += params_.increase;
+    return static_cast<long>(window_);
+  }
+
+  void save_state(state_writer& out) const override {
+    out.put(window_);
+  }
+
+private:
+  credit_policy_params params_;
+  double window_;
+};
+
+class static_policy : public credit_policy {
+public:
+  explicit static_policy(const credit_policy_params& params)
+      : tokens_(static_cast<long>(params.min_tokens)) {
+    // nop
+  }
+
+  const char* name() const override {
+    return "static";
+  }
+
+  long generate_tokens(const credit_cycle&) override {
+    return tokens_;
+  }
+
+  void save_state(state_writer& out) const override {
+    out.put(tokens_);
+  }
+
+private:
+  long tokens_;
+};
+
+} // namespace <anonymous>
+
+credit_policy::~credit_policy() {
+  // nop
+}
+
+const std::vector<std::string>& credit_policy_names() {
+  static const std::vector<std::string> result{"cycle", "pid", "aimd",
+                                               "static"};
+  return result;
+}
+
+credit_policy_ptr make_credit_policy(const std::string& name,
+                                     const credit_policy_params& params) {
+  if (name == "cycle")
+    return std::make_unique<cycle_policy>(params);
+  if (name == "pid")
+    return std::make_unique<pid_policy>(params);
+  if (name == "aimd")
+    return std::make_unique<aimd_policy>(params);
+  if (name == "static")
+    return std::make_unique<static_policy>(params);
+  return nullptr;
+}
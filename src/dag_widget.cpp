@@ -1,19 +1,47 @@
 #include "dag_widget.hpp"
 
 #include <cmath>
+#include <algorithm>
+#include <unordered_map>
 
+#include <QElapsedTimer>
 #include <QKeyEvent>
+#include <QStyleOptionGraphicsItem>
 #include <QTreeView>
 
 #include "edge.hpp"
 #include "entity.hpp"
 #include "node.hpp"
 #include "qstr.hpp"
+#include "environment.hpp"
+#include "layered_layout.hpp"
+#include "simulant_tree_model.hpp"
+
+namespace {
+
+// Caps the number of steps in `shuffle`. Large layouts may never settle
+// completely, the timer keeps animating the remaining moves.
+constexpr int max_shuffle_iterations = 500;
+
+// Caps the time spent in `shuffle`.
+constexpr int max_shuffle_ms = 250;
+
+// Stops relaxing once the average squared move per node drops below this.
+constexpr qreal min_energy_per_node = 0.01;
+
+// Distance between two columns in layered mode.
+constexpr qreal layer_spacing = 100;
+
+// Distance between two nodes in the same column in layered mode.
+constexpr qreal node_spacing = 50;
+
+} // namespace <anonymous>
 
 dag_widget::dag_widget(QWidget* parent)
     : QGraphicsView(parent),
       timerId(0),
-      selected_(nullptr) {
+      selected_(nullptr),
+      mode_(layered) {
   auto scene = new QGraphicsScene(this);
   scene->setItemIndexMethod(QGraphicsScene::NoIndex);
   scene->setSceneRect(-200, -200, 400, 400);
@@ -28,7 +56,8 @@ dag_widget::dag_widget(QWidget* parent)
 }
 
 void dag_widget::itemMoved() {
-  if (!timerId)
+  // Only the force-directed layout animates.
+  if (!timerId && mode_ == force_directed)
     timerId = startTimer(1000 / 25);
 }
 
@@ -37,9 +66,15 @@ void dag_widget::selected(node* x) {
     return;
   auto old = selected_;
   selected_ = x;
+  auto e = x->entity();
+  // Serializing the model reads the state of the simulant.
+  e->env()->synchronized([&] {
+    if (old != nullptr)
+      old->entity()->model()->remove_observer();
+    e->model()->add_observer();
+  });
   if (old != nullptr)
     old->update();
-  auto e = x->entity();
   auto tv = e->parent()->findChild<QTreeView*>(qstr("state"));
   tv->setModel(e->model());
   tv->expandAll();
@@ -66,7 +101,7 @@ void dag_widget::keyPressEvent(QKeyEvent* event) {
       break;
     case Qt::Key_Space:
     case Qt::Key_Enter:
-      shuffle();
+      arrange();
       break;
     default:
       QGraphicsView::keyPressEvent(event);
@@ -74,19 +109,9 @@ void dag_widget::keyPressEvent(QKeyEvent* event) {
 }
 
 void dag_widget::timerEvent(QTimerEvent*) {
-  std::vector<node*> nodes;
-  for (auto item : scene()->items()) {
-    auto ptr = qgraphicsitem_cast<node*>(item);
-    if (ptr)
-      nodes.emplace_back(ptr);
-  }
-  for (auto x : nodes)
-    x->calculateForces();
-  bool items_moved = false;
-  for (auto x : nodes)
-    if (x->advance())
-      items_moved = true;
-  if (items_moved) {
+  auto xs = nodes();
+  qreal energy = 0;
+  if (relax(xs, energy) && energy >= min_energy_per_node * xs.size()) {
     centerize_dag();
   } else {
     killTimer(timerId);
@@ -94,6 +119,28 @@ void dag_widget::timerEvent(QTimerEvent*) {
   }
 }
 
+void dag_widget::drawForeground(QPainter* painter, const QRectF& rect) {
+  auto lod = QStyleOptionGraphicsItem::levelOfDetailFromTransform(transform());
+  if (lod >= min_detail)
+    return;
+  lines_.clear();
+  for (auto x : nodes())
+    for (auto e : x->edges())
+      if (e->source() == x) {
+        // Pad the bounding box of the line, since horizontal and vertical
+        // lines have an empty box.
+        auto l = e->line();
+        auto box = QRectF{l.p1(), l.p2()}.normalized().adjusted(-1, -1, 1, 1);
+        if (rect.intersects(box))
+          lines_.append(l);
+      }
+  painter->save();
+  painter->setRenderHint(QPainter::Antialiasing, false);
+  painter->setPen(QPen(Qt::black, 0));
+  painter->drawLines(lines_);
+  painter->restore();
+}
+
 void dag_widget::scaleView(qreal scaleFactor) {
   qreal factor = transform()
                    .scale(scaleFactor, scaleFactor)
@@ -104,27 +151,50 @@ void dag_widget::scaleView(qreal scaleFactor) {
   scale(scaleFactor, scaleFactor);
 }
 
-void dag_widget::shuffle() {
-  // Collect nodes.
-  std::vector<node*> nodes;
-  for (auto item : scene()->items()) {
-    auto ptr = qgraphicsitem_cast<node*>(item);
-    if (ptr)
-      nodes.emplace_back(ptr);
+void dag_widget::arrange() {
+  if (mode_ == layered)
+    layer();
+  else
+    shuffle();
+}
+
+void dag_widget::layer() {
+  auto xs = nodes();
+  // Sort by creation order of the entities for a stable result.
+  std::sort(xs.begin(), xs.end(), [](node* x, node* y) {
+    return x->entity()->rank() < y->entity()->rank();
+  });
+  std::unordered_map<node*, size_t> indexes;
+  for (size_t i = 0; i < xs.size(); ++i)
+    indexes.emplace(xs[i], i);
+  std::vector<std::pair<size_t, size_t>> es;
+  for (auto x : xs)
+    for (auto e : x->edges())
+      if (e->source() == x)
+        es.emplace_back(indexes[x], indexes[e->dest()]);
+  auto positions = layered_layout(xs.size(), es);
+  for (size_t i = 0; i < xs.size(); ++i) {
+    auto& p = positions[i];
+    auto offset = (static_cast<qreal>(p.layer_size) - 1) / 2;
+    xs[i]->setPos(p.layer * layer_spacing,
+                  (static_cast<qreal>(p.order) - offset) * node_spacing);
   }
+  centerize_dag();
+}
+
+void dag_widget::shuffle() {
+  auto xs = nodes();
   // Shuffle position.
-  for (auto x : nodes)
+  for (auto x : xs)
     x->setPos(-150 + qrand() % 300, -150 + qrand() % 300);
-  // Advance nodes until the scene stabilizes.
-  bool items_moved = true;
-  while (items_moved) {
-    items_moved = false;
-    for (auto x : nodes)
-      x->calculateForces();
-    for (auto x : nodes)
-      if (x->advance())
-        items_moved = true;
-  }
+  // Advance nodes until the scene stabilizes or we run out of budget.
+  QElapsedTimer clock;
+  clock.start();
+  qreal energy = 0;
+  for (int i = 0; i < max_shuffle_iterations; ++i)
+    if (!relax(xs, energy) || energy < min_energy_per_node * xs.size()
+        || clock.elapsed() > max_shuffle_ms)
+      break;
   // Centerize scene.
   centerize_dag();
 }
@@ -137,6 +207,33 @@ void dag_widget::zoomOut() {
   scaleView(1 / qreal(1.2));
 }
 
+std::vector<node*> dag_widget::nodes() {
+  std::vector<node*> result;
+  for (auto item : scene()->items()) {
+    auto ptr = qgraphicsitem_cast<node*>(item);
+    if (ptr)
+      result.emplace_back(ptr);
+  }
+  return result;
+}
+
+bool dag_widget::relax(const std::vector<node*>& xs, qreal& energy) {
+  positions_.clear();
+  for (auto x : xs)
+    positions_.emplace_back(x->pos());
+  repulsion_.build(positions_);
+  for (auto x : xs)
+    x->calculateForces(repulsion_);
+  energy = 0;
+  bool moved = false;
+  for (auto x : xs) {
+    energy += x->energy();
+    if (x->advance())
+      moved = true;
+  }
+  return moved;
+}
+
 void dag_widget::centerize_dag() {
   auto br = scene()->itemsBoundingRect();
   setSceneRect(br);
@@ -1,14 +1,17 @@
 #include <cmath>
 
 #include <QPainter>
+#include <QStyleOptionGraphicsItem>
 
 #include "edge.hpp"
 #include "node.hpp"
+#include "dag_widget.hpp"
 
 namespace {
 
-const double Pi = 3.14159265358979323846264338327950288419717;
-const double TwoPi = 2.0 * Pi;
+// Cosine and sine of 30 degrees, i.e., half the angle at the arrow tip.
+const double cos_30 = 0.86602540378443864676;
+const double sin_30 = 0.5;
 
 } // namespace <anonymous>
 
@@ -36,8 +39,18 @@ void edge::adjust() {
     QPointF edgeOffset{(line.dx() * r) / length, (line.dy() * r) / length};
     source_point_ = line.p1() + edgeOffset;
     dest_point_ = line.p2() - edgeOffset;
+    // Rotate the backwards unit vector by +/- 30 degrees.
+    auto ux = -line.dx() / length;
+    auto uy = -line.dy() / length;
+    QPointF p1{(ux * cos_30 - uy * sin_30) * arrow_size_,
+               (ux * sin_30 + uy * cos_30) * arrow_size_};
+    QPointF p2{(ux * cos_30 + uy * sin_30) * arrow_size_,
+               (-ux * sin_30 + uy * cos_30) * arrow_size_};
+    arrow_head_.clear();
+    arrow_head_ << dest_point_ << dest_point_ + p1 << dest_point_ + p2;
   } else {
     source_point_ = dest_point_ = line.p1();
+    arrow_head_.clear();
   }
 }
 
@@ -52,26 +65,19 @@ QRectF edge::boundingRect() const {
     .adjusted(-extra, -extra, extra, extra);
 }
 
-void edge::paint(QPainter* painter, const QStyleOptionGraphicsItem*, QWidget*) {
-  if (!source_ || !dest_)
+void edge::paint(QPainter* painter, const QStyleOptionGraphicsItem* option,
+                 QWidget*) {
+  if (!source_ || !dest_ || arrow_head_.isEmpty())
     return;
-  QLineF line(source_point_, dest_point_);
-  if (qFuzzyCompare(line.length(), qreal(0.)))
+  // The DAG widget draws all edges at once when zoomed out.
+  auto lod = option->levelOfDetailFromTransform(painter->worldTransform());
+  if (lod < dag_widget::min_detail)
     return;
   // Draw the line.
   painter->setPen(QPen(Qt::black, 1, Qt::SolidLine,
                        Qt::RoundCap, Qt::RoundJoin));
-  painter->drawLine(line);
+  painter->drawLine(line());
   // Draw the arrow.
-  double angle = ::acos(line.dx() / line.length());
-  if (line.dy() >= 0)
-    angle = TwoPi - angle;
-  QPointF destArrowP1 =
-    dest_point_
-    + QPointF(sin(angle - Pi / 3) * arrow_size_, cos(angle - Pi / 3) * arrow_size_);
-  QPointF destArrowP2 = dest_point_
-                        + QPointF(sin(angle - Pi + Pi / 3) * arrow_size_,
-                                  cos(angle - Pi + Pi / 3) * arrow_size_);
   painter->setBrush(Qt::black);
-  painter->drawPolygon(QPolygonF() << line.p2() << destArrowP1 << destArrowP2);
+  painter->drawPolygon(arrow_head_);
 }
@@ -19,21 +19,20 @@
 
 #include "entity.hpp"
 
-#include <QSpinBox>
 #include <QTreeView>
-#include <QListWidget>
 
 #include "qstr.hpp"
+#include "checkpoint.hpp"
 #include "environment.hpp"
 #include "entity_details.hpp"
 #include "critical_section.hpp"
 
 namespace {
 
-class cancel_entity_thread : public std::exception {
+class cancel_entity_fiber : public std::exception {
 public:
   const char* what() const noexcept override {
-    return "entity aborted thread execution";
+    return "entity aborted fiber execution";
   }
 };
 
@@ -42,33 +41,37 @@ public:
 entity::entity(environment* env, QWidget* parent, QString name)
   : env_(env),
     parent_(parent),
+    dialog_(nullptr),
     name_(name),
-    simulant_thread_state_(sts_none),
+    abort_simulant_(false),
     state_(idle),
-    before_tick_state_(idle) {
+    before_tick_state_(idle),
+    refresh_mailbox_(false),
+    started_(false),
+    rank_(0),
+    scheduled_(false),
+    idle_until_(0),
+    idle_ticks_(0) {
   using storage = caf::actor_storage<simulant>;
   auto& sys = env->sys();
   caf::actor_config cfg;
   auto ptr = new storage(sys.next_actor_id(), sys.node(), &sys, cfg, this);
   simulant_.reset(&ptr->data, false);
-  // Parent takes ownership of dialog_.
-  dialog_ = new entity_details(this);
-  dialog_->setWindowTitle(name);
-  dialog_->state->setModel(simulant_->model());
 }
 
 entity::~entity() {
-  if (simulant_thread_state_ != sts_none) {
-    critical_section(simulant_mx_, [&] {
-      simulant_thread_state_ = sts_abort;
-      simulant_resume_cv_.notify_one();
-    });
-    simulant_thread_.join();
+  if (simulant_fiber_) {
+    // Unwind the stack of the fiber before releasing it.
+    abort_simulant_ = true;
+    while (!simulant_fiber_->resume())
+      ; // nop
+    simulant_fiber_.reset();
   }
   simulant_->detach_from_parent();
 }
 
 void entity::before_tick() {
+  report_idle_ticks(env_->timestamp());
   if (state_ == idle && mailbox_ready())
     state_ = read_mailbox;
   before_tick_state_ = state_;
@@ -81,22 +84,80 @@ void entity::tick() {
     case read_mailbox:
       state_ = idle;
       start_handling_next_message();
+      simulant_->touch();
       break;
     case resume_simulant:
       resume();
+      simulant_->touch();
   }
 }
 
 void entity::after_tick() {
-  simulant_->model()->update();
-  if (started_ && before_tick_state_ == idle && state_ == idle)
-    emit idling();
+  if (started_ && before_tick_state_ == idle && state_ == idle) {
+    ++idle_ticks_;
+    emit idling(1);
+  }
+  idle_until_ = env_->timestamp() + 1;
 }
 
 void entity::tock() {
   // nop
 }
 
+void entity::render() {
+  simulant_->model()->update();
+  if (dialog_)
+    dialog_->refresh();
+}
+
+void entity::report_idle_ticks(tick_time t) {
+  // The environment only skips entities without work, i.e., started_ cannot
+  // change in between.
+  if (t > idle_until_) {
+    if (started_) {
+      idle_ticks_ += t - idle_until_;
+      emit idling(t - idle_until_);
+    }
+    idle_until_ = t;
+  }
+}
+
+void entity::save_state(state_writer& out) {
+  out.put(params_.source_rate);
+  out.put(params_.ticks_per_item);
+  out.put(params_.ratio_in);
+  out.put(params_.ratio_out);
+  out.put(params_.source_weight);
+  out.put(static_cast<int>(state_));
+  out.put(started_);
+  out.put(scheduled_);
+  out.put(idle_until_);
+  out.put(idle_ticks_);
+  out.put(batch_progress_.value);
+  out.put(batch_progress_.maximum);
+  out.put(item_progress_.value);
+  out.put(item_progress_.maximum);
+  out.put(current_sender_.toStdString());
+  simulant_->save_state(out);
+}
+
+bool entity::load_parameters(state_reader& in) {
+  parameters x;
+  if (!in.get(x.source_rate) || !in.get(x.ticks_per_item)
+      || !in.get(x.ratio_in) || !in.get(x.ratio_out)
+      || !in.get(x.source_weight))
+    return false;
+  params_ = x;
+  return true;
+}
+
+void entity::create_dialog() {
+  // Parent takes ownership of dialog_.
+  dialog_ = new entity_details(this);
+  dialog_->setWindowTitle(name_);
+  dialog_->state->setModel(simulant_->model());
+}
+
 simulant_tree_model* entity::model() {
   return simulant_->model();
 }
@@ -110,67 +171,50 @@ bool entity::mailbox_ready() {
 }
 
 void entity::show_dialog() {
-  if (!dialog_->isVisible()) {
+  // Most entities never show their dialog, so we only pay for the widgets
+  // on first use.
+  if (dialog_ == nullptr && !env_->headless())
+    env_->create_dialog(this);
+  if (dialog_ && !dialog_->isVisible()) {
     dialog_->show();
     dialog_->raise();
     dialog_->activateWindow();
   }
 }
 
-void entity::progress(QProgressBar* bar, int first, int last) {
-  progress(bar, first, last, [](int) {});
+void entity::progress(progress_state& st, int first, int last) {
+  progress(st, first, last, [](int) {});
 }
 
 void entity::yield() {
-  simulant_thread_state_ = sts_yield;
-  simulant_yield_cv_.notify_one();
-  simulant_thread_state st;
-  do {
-    simulant_resume_cv_.wait(*simulant_resume_guard_);
-    st = simulant_thread_state_.load();
-  } while (st == sts_yield);
-  if (st == sts_abort)
-    throw cancel_entity_thread();
+  simulant_fiber_->yield();
+  if (abort_simulant_)
+    throw cancel_entity_fiber();
 }
 
 void entity::resume() {
-  critical_section(simulant_mx_, [&](auto& guard) {
-    // Wait for the simulant in case it is still running.
-    while (simulant_thread_state_ == sts_resume)
-      simulant_yield_cv_.wait(guard);
-    simulant_thread_state_ = sts_resume;
-    simulant_resume_cv_.notify_one();
-    do {
-      simulant_yield_cv_.wait(guard);
-    } while (simulant_thread_state_ == sts_resume);
-    if (simulant_thread_state_ == sts_finalize) {
-      simulant_thread_.join();
-      simulant_thread_ = std::thread{};
-      simulant_thread_state_ = sts_none;
-      state_ = idle;
-    } else if (state_ != resume_simulant) {
-      state_ = resume_simulant;
-    }
-  });
+  CAF_SET_LOGGER_SYS(&(simulant_->system()));
+  CAF_SET_AID(simulant_->id());
+  if (simulant_fiber_->resume()) {
+    simulant_fiber_.reset();
+    state_ = idle;
+  } else if (state_ != resume_simulant) {
+    state_ = resume_simulant;
+  }
 }
 
 void entity::start_handling_next_message() {
   if (!mailbox_ready())
     return;
-  delete dialog_->mailbox->takeItem(0);
-  assert(simulant_thread_state_ == sts_none);
-  simulant_thread_ = std::thread{[=] {
-    CAF_SET_LOGGER_SYS(&(simulant_->system()));
-    CAF_SET_AID(simulant_->id());
-    critical_section(simulant_mx_, [&](auto& guard) {
-      while (simulant_thread_state_ != sts_resume)
-        simulant_resume_cv_.wait(guard);
-      simulant_resume_guard_ = &guard;
+  refresh_mailbox();
+  assert(simulant_fiber_ == nullptr);
+  simulant_fiber_.reset(new fiber{[=] {
+    try {
       simulant_->resume(env_->sys().dummy_execution_unit(), 1);
-      simulant_thread_state_ = sts_finalize;
-      simulant_yield_cv_.notify_one();
-    });
-  }};
+    } catch (cancel_entity_fiber&) {
+      // The entity is shutting down.
+    }
+  }});
   resume();
 }
 
@@ -1,5 +1,7 @@
 #include "entity_details.hpp"
 
+#include "caf/mailbox_element.hpp"
+
 #include "entity.hpp"
 #include "source.hpp"
 #include "sink.hpp"
@@ -12,7 +14,6 @@ namespace {
 struct render_mailbox_visitor {
   QListWidget* lw;
   QString from;
-  int id;
 
   void operator()(const caf::stream_msg::open& x) {
     add(qstr("From: %1 -> open with priority %2")
@@ -48,7 +49,6 @@ struct render_mailbox_visitor {
   void add(QString x) {
     auto item = new QListWidgetItem;
     item->setText(x);
-    item->setData(Qt::UserRole, id);
     lw->insertItem(lw->count(), item); // takes ownership
   }
 };
@@ -57,14 +57,29 @@ struct render_mailbox_visitor {
 
 entity_details::entity_details(entity* ptr)
     : QDialog(ptr->parent()),
-      env_(ptr->env()) {
+      entity_(ptr),
+      env_(ptr->env()),
+      has_sink_widgets_(true),
+      has_source_widgets_(true) {
   setupUi(this);
-  connect(ptr, SIGNAL(idling()), sink_idle_ticks, SLOT(stepUp()));
-  connect(
-    ptr, SIGNAL(message_received(int, caf::strong_actor_ptr, caf::message)),
-    SLOT(entity_received_message(int, caf::strong_actor_ptr, caf::message)));
-  connect(ptr, SIGNAL(message_consumed(int)),
-          SLOT(entity_consumed_message(int)));
+  // Stages are sources and sinks at the same time.
+  auto is_source = dynamic_cast<source*>(ptr) != nullptr;
+  auto is_sink = dynamic_cast<sink*>(ptr) != nullptr;
+  if (is_source && is_sink) {
+    drop_source_only_widgets();
+  } else if (is_source) {
+    drop_sink_widgets();
+    drop_stage_widgets();
+  } else {
+    drop_stage_widgets();
+    drop_source_widgets();
+  }
+  auto& params = ptr->params();
+  bind(source_rate, params.source_rate);
+  bind(source_weight, params.source_weight);
+  bind(sink_ticks_per_item, params.ticks_per_item);
+  bind(ratio_in, params.ratio_in);
+  bind(ratio_out, params.ratio_out);
 }
 
 entity_details::~entity_details() {
@@ -72,6 +87,7 @@ entity_details::~entity_details() {
 }
 
 void entity_details::drop_sink_widgets() {
+  has_sink_widgets_ = false;
   drop_by_prefix(qstr("sink"));
 }
 
@@ -80,6 +96,7 @@ void entity_details::drop_stage_widgets() {
 }
 
 void entity_details::drop_source_widgets() {
+  has_source_widgets_ = false;
   drop_by_prefix(qstr("source"));
 }
 
@@ -90,25 +107,72 @@ void entity_details::drop_source_only_widgets() {
     obj->deleteLater();
 }
 
-void entity_details::entity_received_message(int id, caf::strong_actor_ptr from,
-                                             caf::message content) {
-  render_mailbox_visitor v{mailbox, env_->id_by_handle(from), id};
-  if (content.match_elements<caf::stream_msg>()) {
-    auto& sm = content.get_as<caf::stream_msg>(0);
-    caf::visit(v, sm.content);
-  } else {
-    v(content);
+void entity_details::refresh() {
+  if (isVisible())
+    render();
+}
+
+void entity_details::showEvent(QShowEvent* event) {
+  // Catch up on everything we skipped while hidden.
+  env_->synchronized([&] {
+    entity_->model()->add_observer();
+    render();
+    entity_->mailbox_changed();
+    render_mailbox();
+  });
+  QDialog::showEvent(event);
+}
+
+void entity_details::hideEvent(QHideEvent* event) {
+  env_->synchronized([&] { entity_->model()->remove_observer(); });
+  QDialog::hideEvent(event);
+}
+
+void entity_details::render() {
+  auto render_bar = [](QProgressBar* bar, const entity::progress_state& x) {
+    if (bar->maximum() != x.maximum)
+      bar->setMaximum(x.maximum);
+    if (bar->value() != x.value)
+      bar->setValue(x.value);
+  };
+  // Stages only render progress of their sink widgets.
+  if (has_sink_widgets_) {
+    if (sink_current_sender->text() != entity_->current_sender())
+      sink_current_sender->setText(entity_->current_sender());
+    render_bar(sink_batch_progress, entity_->batch_progress());
+    render_bar(sink_item_progress, entity_->item_progress());
+  } else if (has_source_widgets_) {
+    render_bar(source_batch_generation, entity_->batch_progress());
+    render_bar(source_item_generation, entity_->item_progress());
   }
+  if (has_sink_widgets_ && sink_idle_ticks->value() != entity_->idle_ticks())
+    sink_idle_ticks->setValue(entity_->idle_ticks());
+  if (entity_->mailbox_changed())
+    render_mailbox();
 }
 
-void entity_details::entity_consumed_message(int id) {
-  for (int row = 0; row < mailbox->count(); ++row) {
-    auto item = mailbox->item(row);
-    if (item->data(Qt::UserRole) == id) {
-      delete item;
-      return;
+void entity_details::render_mailbox() {
+  mailbox->clear();
+  entity_->sim()->iterate_mailbox([&](auto& x) {
+    render_mailbox_visitor v{mailbox, env_->id_by_handle(x.sender)};
+    auto content = x.copy_content_to_message();
+    if (content.match_elements<caf::stream_msg>()) {
+      auto& sm = content.get_as<caf::stream_msg>(0);
+      caf::visit(v, sm.content);
+    } else {
+      v(content);
     }
-  }
+  });
+}
+
+void entity_details::bind(QSpinBox* x, int& field) {
+  x->setValue(field);
+  using signal_t = void (QSpinBox::*)(int);
+  // The simulation thread reads `field` while running ticks.
+  connect(x, static_cast<signal_t>(&QSpinBox::valueChanged),
+          [this, &field](int value) {
+            env_->synchronized([&] { field = value; });
+          });
 }
 
 void entity_details::drop_by_prefix(const QString& prefix) {
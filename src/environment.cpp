@@ -1,16 +1,36 @@
 #include "environment.hpp"
 
+#include <tuple>
+#include <chrono>
 #include <string>
+#include <numeric>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <algorithm>
 
 #include <QDebug>
 
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#elif defined(__linux__)
+#include <unistd.h>
+#endif
+
 #include "caf/actor_system.hpp"
 #include "caf/actor_system_config.hpp"
 #include "caf/message.hpp"
+#include "caf/mailbox_element.hpp"
 
 #include "caf/scheduler/abstract_coordinator.hpp"
 
+#include "qstr.hpp"
 #include "sink.hpp"
+#include "stage.hpp"
+#include "source.hpp"
+#include "sweep.hpp"
+#include "credit_policy.hpp"
+#include "trace.hpp"
 #include "mainwindow.hpp"
 
 namespace {
@@ -38,19 +58,89 @@ protected:
   }
 };
 
+/// Returns the resident set size of this process in bytes or 0 if unknown.
+size_t resident_memory() {
+#if defined(__APPLE__)
+  mach_task_basic_info info;
+  mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+  if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO,
+                reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS)
+    return 0;
+  return info.resident_size;
+#elif defined(__linux__)
+  auto f = fopen("/proc/self/statm", "r");
+  if (f == nullptr)
+    return 0;
+  unsigned long total = 0;
+  unsigned long resident = 0;
+  auto n = fscanf(f, "%lu %lu", &total, &resident);
+  fclose(f);
+  if (n != 2)
+    return 0;
+  return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#else
+  return 0;
+#endif
+}
+
+/// Returns how much the resident memory grew since `before`.
+size_t resident_memory_since(size_t before) {
+  auto now = resident_memory();
+  return now > before ? now - before : 0;
+}
+
+void save(state_writer& out, const latency_stats& x) {
+  out.put(x.count());
+  out.put(x.sum());
+  out.put(x.min());
+  out.put(x.max());
+  out.put(x.buckets().size());
+  for (auto n : x.buckets())
+    out.put(n);
+}
+
 } // namespace <anonymous>
 
 environment::config::config() {
   load<nop_coordinator>();
-}
-
-environment::enqueued_message::enqueued_message(int id_arg,
-                                                tick_time timestamp_arg,
-                                                caf::strong_actor_ptr from_arg,
-                                                caf::message content_arg)
-    : id(id_arg), timestamp(timestamp_arg), from(std::move(from_arg)),
-      content(std::move(content_arg)) {
-  // nop
+  opt_group{custom_options_, "global"}
+  .add(headless, "headless", "run simulation without GUI")
+  .add(ticks, "ticks", "number of simulated ticks in headless mode")
+  .add(layout, "layout", "topology in headless mode, e.g., \"src1,snk1\"")
+  .add(graph_layout, "graph-layout", "node placement: layered or force")
+  .add(skip_idle_ticks, "skip-idle-ticks",
+       "advance time to the next event while all entities are idle")
+  .add(trace_file, "trace-file", "write binary trace records to this file")
+  .add(record_file, "record-file", "record the simulation to this file")
+  .add(replay_file, "replay-file", "replay the recording in this file")
+  .add(replay_seek, "replay-seek",
+       "re-simulate a replay up to this tick before showing it")
+  .add(seed, "seed", "seed for the random number generator (0 = random)")
+  .add(checkpoint_file, "checkpoint-file", "write a checkpoint to this file")
+  .add(checkpoint_at, "checkpoint-at", "write the checkpoint at this tick")
+  .add(verify_file, "verify-checkpoint",
+       "re-simulate up to this checkpoint and fail if the state differs")
+  .add(cycle_duration, "cycle-duration", "credit cycle length in ticks")
+  .add(min_tokens, "min-tokens", "minimum number of tokens per cycle")
+  .add(desired_batch_complexity, "desired-batch-complexity",
+       "desired processing time per batch in ticks")
+  .add(target_queueing_delay, "target-queueing-delay",
+       "desired mailbox delay of batches in ticks for pid and aimd")
+  .add(min_batch_size, "min-batch-size", "minimum number of items per batch")
+  .add(max_min_fairness, "max-min-fairness",
+       "hand credit unused by slow sources to backlogged sources")
+  .add(credit_policy, "credit-policy",
+       "credit policy of sinks: cycle, pid, aimd or static")
+  .add(credit_policies, "credit-policies",
+       "credit policy per sink, e.g., \"snk1=aimd,snk2=pid\"")
+  .add(compare_credit_policies, "compare-credit-policies",
+       "run a sweep with one grid point per credit policy")
+  .add(latency_target, "latency-target",
+       "tune batch sizes for this batch latency in ticks (0 = off)")
+  .add(sweep, "sweep", "parameter grid, e.g., \"min-tokens=10,100;...\"")
+  .add(sweep_seeds, "sweep-seeds", "number of seeds per grid point")
+  .add(sweep_threads, "sweep-threads", "number of worker threads (0 = all)")
+  .add(sweep_report, "sweep-report", "output file (.csv or .json)");
 }
 
 environment::tick_event::~tick_event() {
@@ -58,15 +148,65 @@ environment::tick_event::~tick_event() {
 }
 
 environment::environment(int argc, char** argv)
-  : sys_(cfg_.parse(argc, argv)),
+  : args_(argv, argv + argc),
+    sys_(cfg_.parse(argc, argv)),
     main_window_(nullptr),
     running_(false),
+    min_delay_(1),
+    max_delay_(1),
     time_(0),
-    rng_(rng_device_()) {
+    seed_(cfg_.seed != 0 ? static_cast<uint32_t>(cfg_.seed)
+                         : rng_device_()),
+    rng_(seed_),
+    checkpoint_pending_(false),
+    entity_memory_(0),
+    dialog_memory_(0),
+    num_dialogs_(0),
+    tick_rate_(0),
+    tick_target_(0),
+    pause_requests_(0),
+    worker_paused_(true),
+    worker_shutdown_(false) {
     // nop
 }
 
-void environment::run() {
+bool environment::run() {
+  if (!cfg_.sweep.empty() || cfg_.compare_credit_policies)
+    return run_sweep();
+  if (!cfg_.replay_file.empty()) {
+    replayer_ = std::make_unique<replay_log_reader>();
+    if (!replayer_->open(cfg_.replay_file)) {
+      fprintf(stderr, "Cannot open replay log: %s\n",
+              cfg_.replay_file.c_str());
+      replayer_.reset();
+      return false;
+    }
+    seed_ = replayer_->seed();
+    cfg_.layout = replayer_->layout();
+  }
+  if (!cfg_.verify_file.empty()) {
+    verify_ = std::make_unique<checkpoint>();
+    if (!verify_->load(cfg_.verify_file)) {
+      fprintf(stderr, "Cannot read checkpoint: %s\n",
+              cfg_.verify_file.c_str());
+      verify_.reset();
+      return false;
+    }
+    seed_ = verify_->seed;
+    cfg_.layout = verify_->layout;
+    min_delay_ = verify_->min_delay;
+    max_delay_ = verify_->max_delay;
+  }
+  if (!cfg_.trace_file.empty() && !trace_open(cfg_.trace_file))
+    fprintf(stderr, "Cannot open trace file: %s\n", cfg_.trace_file.c_str());
+  auto result = headless() ? run_headless() : run_gui();
+  recorder_.reset();
+  replayer_.reset();
+  trace_close();
+  return result;
+}
+
+bool environment::run_gui() {
   // Reset any state.
   time_ = 0;
   // Get CLI arguments for Qt.
@@ -84,46 +224,235 @@ void environment::run() {
   // Initialize main window and start all entities.
   connect_slots(main_window_.get());
   main_window_->show();
+  auto err = start_entities();
+  if (!err.isEmpty()) {
+    fprintf(stderr, "%s\n", err.toUtf8().constData());
+    main_window_.reset();
+    clear_entities();
+    disconnect();
+    return false;
+  }
+  // Simulate on a separate thread and let the GUI thread render snapshots.
+  running_ = true;
+  worker_shutdown_ = false;
+  worker_ = std::thread{[=] { run_worker(); }};
   main_window_->start();
-  for (auto& e : entities_)
-      e->start();
-  run_tick_events();
-  // We start at tick count 1. Some entities send messages during
-  // `start()`, i.e., "tick 0".
-  time_ = 1;
   // Enter Qt's event loop.
-  running_ = true;
   app.setQuitOnLastWindowClosed(true);
   app.exec();
+  stop_worker();
   running_ = false;
+  print_memory_usage();
   // Clean up all state except the CAF system.
   main_window_.reset();
-  entities_.clear();
+  clear_entities();
   disconnect();
+  return true;
 }
 
-entity* environment::entity_by_id(const QString& x) const {
-  auto pred = [&](const entity_ptr& y) {
-    assert(y != nullptr);
-    return x == y->id();
+bool environment::run_headless() {
+  run_summary result;
+  auto err = simulate(result, true);
+  if (!err.isEmpty()) {
+    fprintf(stderr, "%s\n", err.toUtf8().constData());
+    return false;
+  }
+  return true;
+}
+
+QString environment::simulate(run_summary& result, bool print) {
+  // Reset any state.
+  time_ = 0;
+  auto err = load_layout(nullptr, qstr(cfg_.layout));
+  if (!err.isEmpty()) {
+    clear_entities();
+    return qstr("Cannot load layout: ") + err;
+  }
+  err = start_entities();
+  if (!err.isEmpty()) {
+    clear_entities();
+    return err;
+  }
+  // Advance time in a tight loop without any event loop.
+  running_ = true;
+  run_until(cfg_.ticks + 1);
+  running_ = false;
+  flush_idle_times();
+  result.ticks = time_;
+  auto& stats = global_latency_;
+  result.throughput = static_cast<double>(stats.count()) / time_;
+  result.avg_latency = stats.count() > 0
+                       ? static_cast<double>(stats.sum()) / stats.count()
+                       : 0.;
+  result.p50 = stats.percentile(.5);
+  result.p99 = stats.percentile(.99);
+  result.p999 = stats.percentile(.999);
+  result.idle = average_global_idle_percentage();
+  result.credit_oscillation = credit_oscillation();
+  if (print)
+    print_metrics();
+  // Clean up all state except the CAF system.
+  clear_entities();
+  disconnect();
+  return {};
+}
+
+bool environment::run_sweep() {
+  std::vector<sweep::axis> grid;
+  std::string err;
+  if (!cfg_.sweep.empty() && !sweep::parse_grid(cfg_.sweep, grid, err)) {
+    fprintf(stderr, "Invalid sweep grid: %s\n", err.c_str());
+    return false;
+  }
+  if (cfg_.compare_credit_policies) {
+    // Run the same topology under each policy.
+    auto is_policy = [](const sweep::axis& x) {
+      return x.name == "credit-policy";
+    };
+    grid.erase(std::remove_if(grid.begin(), grid.end(), is_policy),
+               grid.end());
+    grid.insert(grid.begin(),
+                sweep::axis{"credit-policy", credit_policy_names()});
+  }
+  sweep runner{args_, std::move(grid), cfg_.sweep_seeds, cfg_.sweep_threads};
+  runner.run();
+  if (!runner.write_report(cfg_.sweep_report)) {
+    fprintf(stderr, "Cannot write sweep report: %s\n",
+            cfg_.sweep_report.c_str());
+    return false;
+  }
+  return true;
+}
+
+QString environment::start_entities() {
+  tick_events_.reset();
+  network_queue_.reset();
+  rng_.seed(seed_);
+  if (!cfg_.record_file.empty()) {
+    recorder_ = std::make_unique<replay_log_writer>();
+    if (!recorder_->open(cfg_.record_file, seed_, layout_)) {
+      fprintf(stderr, "Cannot open record file: %s\n",
+              cfg_.record_file.c_str());
+      recorder_.reset();
+    }
+  }
+  if (replayer_ != nullptr)
+    replayer_->seek(0);
+  checkpoint_pending_ = !cfg_.checkpoint_file.empty() && cfg_.checkpoint_at > 0;
+  if (verify_ != nullptr)
+    apply_checkpoint_parameters();
+  for (auto& e : entities_) {
+    e->start();
+    activate(e.get());
+  }
+  deliver_messages();
+  run_tick_events();
+  // We start at tick count 1. Some entities send messages during
+  // `start()`, i.e., "tick 0".
+  time_ = 1;
+  // Fast-forward a replay to the requested tick without updating any view.
+  // This re-simulates all ticks before it, since tick events are opaque.
+  if (replayer_ != nullptr && cfg_.replay_seek > time_)
+    run_until(cfg_.replay_seek);
+  if (verify_ != nullptr)
+    return verify_checkpoint();
+  return {};
+}
+
+QString environment::load_layout(QWidget* parent, const QString& layout) {
+  assert(!running_);
+  auto cell_error = [](QString text, int row, int col) {
+    text += " in cell (";
+    text += QString::number(row);
+    text += ", ";
+    text += QString::number(col);
+    text += ")";
+    return text;
   };
-  auto e = entities_.end();
-  auto i = std::find_if(entities_.begin(), e, pred);
-  if (i != e)
-    return i->get();
-  return nullptr;
+  auto memory_before = resident_memory();
+  // We expect a line like "src1,src2;snk1,snk1".
+  // ',' separates columns and ';' separates rows.
+  auto rows = layout.split(";");
+  if (rows.empty())
+    return qstr("No scheme to load in first line");
+  QVector<QStringList> input_matrix;
+  for (auto& row : rows)
+    input_matrix.append(row.split(","));
+  // Make sure all columns are of equal size.
+  auto height = input_matrix.size();
+  auto width = input_matrix[0].size();
+  if (width < 2)
+    return qstr("Layout contains only a single column");
+  for (auto& row : input_matrix)
+    if (row.size() != width)
+      return qstr("Columns are not of equal size");
+  // Parse the input matrix to create all entities and to extract dependencies.
+  edge_map edges;
+  for (auto row = 0; row < height; ++row) {
+    // Keep track of last seen source.
+    source* bt = nullptr;
+    for (auto col = 0; col < width; ++col) {
+      auto& cell_text = input_matrix[row][col];
+      if (cell_text.size() < 4 && cell_text != "-") {
+        return cell_error("Invalid text \"" + cell_text + "\"", row, col);
+      } else if (cell_text.startsWith("src")) {
+        if (bt != nullptr)
+          return cell_error("Misplaced source", row, col);
+        bt = get_entity<source>(parent, cell_text);
+      } else if (cell_text.startsWith("stg")) {
+        if (bt == nullptr)
+          return cell_error("Misplaced stage", row, col);
+        auto ptr = get_entity<stage>(parent, cell_text);
+        edges.emplace(bt, ptr);
+        bt = ptr;
+      } else if (cell_text.startsWith("snk")) {
+        if (bt == nullptr)
+          return cell_error("Misplaced sink", row, col);
+        auto ptr = get_entity<sink>(parent, cell_text);
+        edges.emplace(bt, ptr);
+        bt = nullptr;
+      } else if (cell_text != "-") {
+        return cell_error("Invalid text \"" + cell_text + "\"", row, col);
+      }
+    }
+  }
+  // Connect sources to sinks.
+  for (auto& kvp : edges) {
+    kvp.first->add_consumer(kvp.second->handle());
+    edges_.emplace(kvp);
+  }
+  // Pick credit policies before starting any sink.
+  auto& names = credit_policy_names();
+  auto known = [&](const std::string& x) {
+    return std::find(names.begin(), names.end(), x) != names.end();
+  };
+  if (!known(cfg_.credit_policy))
+    return qstr("Unknown credit policy \"")
+           + QString::fromStdString(cfg_.credit_policy) + "\"";
+  credit_policies_.clear();
+  for (auto& entry : qstr(cfg_.credit_policies).split(",",
+                                                      QString::SkipEmptyParts)) {
+    auto kvp = entry.split("=");
+    if (kvp.size() != 2 || !known(kvp[1].toStdString()))
+      return "Invalid credit policy \"" + entry + "\"";
+    if (!has_entity(kvp[0]))
+      return "Credit policy for unknown entity \"" + kvp[0] + "\"";
+    credit_policies_.insert(kvp[0], kvp[1].toStdString());
+  }
+  layout_ = layout.toStdString();
+  entity_memory_ = resident_memory_since(memory_before);
+  return {};
+}
+
+entity* environment::entity_by_id(const QString& x) const {
+  return entities_by_id_.value(x, nullptr);
 }
 
 entity* environment::entity_by_handle(const caf::actor_addr& x) const {
-  auto pred = [&](const entity_ptr& y) {
-    assert(y != nullptr);
-    return x == y->handle();
-  };
-  auto e = entities_.end();
-  auto i = std::find_if(entities_.begin(), e, pred);
-  if (i != e)
-    return i->get();
-  return nullptr;
+  if (!x)
+    return nullptr;
+  auto i = entities_by_handle_.find(x.id());
+  return i != entities_by_handle_.end() ? i->second : nullptr;
 }
 
 QString environment::id_by_handle(const caf::actor_addr& x) const {
@@ -132,89 +461,203 @@ QString environment::id_by_handle(const caf::actor_addr& x) const {
 }
 
 void environment::post(tick_duration delay, tick_event_uptr x) {
-  critical_section(tick_events_mtx_, [&] {
-    auto t = time_ + (delay >= 0 ? delay : random_delay());
-    tick_events_[t].emplace_back(std::move(x));
+  critical_section(rng_mtx_, [&] {
+    if (delay < 0)
+      delay = random_delay();
+    tick_duration logged;
+    if (replayer_ != nullptr
+        && (!replayer_->tick_event(time_, logged) || logged != delay))
+      replay_diverged();
+    if (recorder_ != nullptr)
+      recorder_->tick_event(time_, delay);
   });
+  critical_section(tick_events_mtx_,
+                   [&] { tick_events_.push(time_ + delay, std::move(x)); });
 }
 
 tick_duration environment::random_delay() {
-  return 3; // fair dice
+  auto r_0 = min_delay_;
+  auto r_n = std::max(max_delay_, r_0);
+  if (r_0 == r_n)
+    return r_0;
+  std::uniform_int_distribution<tick_duration> f(r_0, r_n);
+  return f(rng_);
+}
+
+void environment::print_metrics() {
+  flush_idle_times();
+  printf("simulated ticks: %d\n", static_cast<int>(time_));
+  for (auto& e : entities_) {
+    auto x = e.get();
+    auto& stats = latency(x);
+    printf("%s: avg latency %d, p50 %d, p99 %d, p999 %d, idle %.2f%%\n",
+           x->id().toUtf8().constData(), static_cast<int>(stats.mean()),
+           static_cast<int>(stats.percentile(.5)),
+           static_cast<int>(stats.percentile(.99)),
+           static_cast<int>(stats.percentile(.999)), idle_percentage(x));
+  }
+  auto& stats = global_latency_;
+  printf("global: avg latency %d, p50 %d, p99 %d, p999 %d, sink idle %.2f%%\n",
+         static_cast<int>(stats.mean()),
+         static_cast<int>(stats.percentile(.5)),
+         static_cast<int>(stats.percentile(.99)),
+         static_cast<int>(stats.percentile(.999)),
+         average_global_idle_percentage());
+  if (!token_stats_.empty())
+    printf("credit: oscillation %.3f\n", credit_oscillation());
+  print_memory_usage();
+  fflush(stdout);
+}
+
+void environment::print_memory_usage() {
+  if (entities_.empty() || entity_memory_ == 0)
+    return;
+  printf("memory: %d entities, %.1f KiB per entity",
+         static_cast<int>(entities_.size()),
+         entity_memory_ / 1024. / entities_.size());
+  if (num_dialogs_ > 0)
+    printf(", %d dialogs, %.1f KiB per dialog", static_cast<int>(num_dialogs_),
+           dialog_memory_ / 1024. / num_dialogs_);
+  putchar('\n');
+}
+
+void environment::create_dialog(entity* x) {
+  auto memory_before = resident_memory();
+  x->create_dialog();
+  dialog_memory_ += resident_memory_since(memory_before);
+  ++num_dialogs_;
+}
+
+void environment::min_delay(int x) {
+  synchronized([&] { min_delay_ = x; });
+}
+
+void environment::max_delay(int x) {
+  synchronized([&] { max_delay_ = x; });
+}
+
+void environment::tick_rate(int x) {
+  critical_section(worker_mtx_, [&] { tick_rate_ = x; });
+  worker_cv_.notify_all();
 }
 
 void environment::post(tick_event_uptr x) {
   post(0, std::move(x));
 }
 
-void environment::tick() {
-  tick(false);
+void environment::manual_tick() {
+  auto n = main_window_->manual_tick_count->value();
+  synchronized([&] {
+    critical_section(worker_mtx_, [&] {
+      tick_target_ = std::max(tick_target_, time_) + n;
+    });
+  });
 }
 
-void environment::manual_tick() {
-  for (int i = 0; i < main_window_->manual_tick_count->value(); ++i)
-    tick(true);
+void environment::render_frame() {
+  synchronized([&] {
+    main_window_->render();
+    flush_idle_times();
+    for (auto& kvp : idle_times_)
+      emit idle_percentage_changed(kvp.first, idle_percentage(kvp.second));
+    emit average_global_idle_percentage_changed(average_global_idle_percentage());
+    emit average_global_latency_changed(average_global_latency());
+    emit global_latency_percentiles_changed(global_latency_.percentile(.5),
+                                            global_latency_.percentile(.99),
+                                            global_latency_.percentile(.999));
+    // Percentiles scan all buckets, so we compute them once per frame rather
+    // than for each consumed message.
+    for (auto& kvp : latency_stats_) {
+      auto& stats = kvp.second;
+      emit average_latency_changed(kvp.first, stats.mean());
+      emit latency_percentiles_changed(kvp.first, stats.percentile(.5),
+                                       stats.percentile(.99),
+                                       stats.percentile(.999));
+    }
+    for (auto& e : entities_)
+      e->render();
+  });
 }
 
-void environment::sink_idling() {
-  printf("sink_idling\n"); fflush(stdout);
-  auto x = qobject_cast<entity*>(sender());
-  if (x != nullptr && x->started())
-    ++idle_times_[x];
+void environment::sink_idling(entity* x, int ticks) {
+  if (x->started()) {
+    TRACE_DEBUG(trace_event::sink_idling, x->rank(), time_, ticks);
+    idle_times_[x] += ticks;
+  }
 }
 
-void environment::entity_received_message(int id, caf::strong_actor_ptr from,
+void environment::entity_received_message(entity* x, int id,
+                                          caf::strong_actor_ptr,
                                           caf::message content) {
-  auto x = qobject_cast<entity*>(sender());
-  if (x == nullptr)
-    return;
-  printf("%s received msg #%d (t %d): %s\n", x->id().toUtf8().constData(), id, (int) time_, to_string(content).c_str()); fflush(stdout);
-  enqueued_messages_[x].emplace_back(id, timestamp(), std::move(from),
-                                      std::move(content));
+  TRACE_DEBUG(trace_event::message_received, x->rank(), time_, id,
+              content.type_token());
+  in_flight_[x->rank_].add(id, timestamp());
 }
 
-void environment::entity_consumed_message(int id) {
-  auto pred = [id](const enqueued_message& y) {
-    return y.id == id;
-  };
-  auto x = qobject_cast<entity*>(sender());
-  if (x == nullptr)
-    return;
-  printf("%s consumed msg #%d (t %d)\n", x->id().toUtf8().constData(), id, (int) time_); fflush(stdout);
-  auto& ifms = enqueued_messages_[x];
-  auto e = ifms.end();
-  auto i = std::find_if(ifms.begin(), e, pred);
-  if (i == e) {
+std::string environment::credit_policy_of(const entity* x) const {
+  return credit_policies_.value(x->id(), cfg_.credit_policy);
+}
+
+void environment::record_tokens(entity* x, long tokens) {
+  auto& st = token_stats_[x];
+  if (st.cycles > 0)
+    st.sum_of_changes += std::abs(tokens - st.last);
+  st.last = tokens;
+  st.sum += tokens;
+  ++st.cycles;
+}
+
+double environment::credit_oscillation() const {
+  double sum = 0;
+  size_t n = 0;
+  for (auto& kvp : token_stats_) {
+    auto& st = kvp.second;
+    if (st.cycles < 2 || st.sum <= 0)
+      continue;
+    auto mean_change = st.sum_of_changes / (st.cycles - 1);
+    sum += mean_change / (st.sum / st.cycles);
+    ++n;
+  }
+  return n > 0 ? sum / n : 0.;
+}
+
+bool environment::receive_time(entity* x, int id, tick_time& t) {
+  return in_flight_[x->rank_].find(id, t);
+}
+
+void environment::entity_consumed_message(entity* x, int id) {
+  TRACE_DEBUG(trace_event::message_consumed, x->rank(), time_, id);
+  tick_time t_0;
+  if (!in_flight_[x->rank_].remove(id, t_0)) {
     qDebug() << "received entity_consumed_message twice or missing "
                 "matching entity_received_message signal";
     return;
   }
-  auto t_0 = i->timestamp;
   auto t_now = timestamp();
   assert(t_0 < t_now);
-  ifms.erase(i);
-  latency_samples_[x].emplace_back(t_now - t_0);
-  //emit average_global_latency_changed(average_global_latency());
+  auto& stats = latency_stats_[x];
+  stats.record(t_now - t_0);
+  global_latency_.record(t_now - t_0);
 }
 
 tick_duration environment::average_latency(entity* x) {
-  auto& xs = latency_samples_[x];
-  if (xs.empty())
-    return 0;
-  return std::accumulate(xs.begin(), xs.end(), tick_duration{0})
-         / static_cast<tick_duration>(xs.size());
+  return latency(x).mean();
 }
 
 tick_duration environment::average_global_latency() {
-  tick_duration sum = 0;
-  size_t count = 0;
-  for (auto& kvp : latency_samples_) {
-    auto& xs = kvp.second;
-    sum += std::accumulate(xs.begin(), xs.end(), tick_duration{0});
-    count += xs.size();
-  }
-  if (sum == 0)
-    return 0;
-  return sum / static_cast<tick_duration>(count);
+  return global_latency_.mean();
+}
+
+tick_duration environment::latency_percentile(entity* x, double q) {
+  return latency(x).percentile(q);
+}
+
+tick_duration environment::global_latency_percentile(double q) {
+  return global_latency_.percentile(q);
+}
+
+const latency_stats& environment::latency(entity* x) {
+  return latency_stats_[x];
 }
 
 double environment::idle_percentage(entity* x) {
@@ -232,81 +675,352 @@ double environment::average_global_idle_percentage() {
 
 void environment::transmit(caf::strong_actor_ptr receiver,
                            caf::mailbox_element_ptr content) {
-  auto t = timestamp();
-  auto r_0 = main_window_->min_delay->value();
-  auto r_n = std::max(main_window_->max_delay->value(), r_0);
-  if (r_0 == r_n) {
-    t += r_0;
-  } else {
-    std::uniform_int_distribution<int> f(r_0, r_n);
-    t += f(rng_);
-  }
+  // Replays take the delay from the log, regardless of the configured bounds.
+  // We still draw a delay to keep `rng_` in step with the recorded run.
+  auto rank = rank_of(receiver);
+  tick_duration delay = 0;
+  critical_section(rng_mtx_, [&] {
+    delay = random_delay();
+    tick_duration logged;
+    if (replayer_ != nullptr) {
+      if (replayer_->delivery(time_, rank, logged))
+        delay = logged;
+      else
+        replay_diverged();
+    }
+    if (recorder_ != nullptr)
+      recorder_->delivery(time_, rank, delay);
+  });
+  auto t = timestamp() + delay;
   critical_section(network_queue_mtx_, [&] {
-    network_queue_.emplace(t, in_flight_message{std::move(receiver),
-                                                std::move(content)});
+    network_queue_.push(t, in_flight_message{std::move(receiver),
+                                             std::move(content)});
   });
 }
 
 double environment::idle_percentage(tick_duration x) {
-  return x == 0 ? 0. : (static_cast<double>(time_) / x) * 100.;
+  return time_ == 0 ? 0. : (static_cast<double>(x) / time_) * 100.;
 }
 
-void environment::tick(bool silent) {
+void environment::tick() {
+  // Only visit entities that have something to do, in order of creation.
+  using std::swap;
+  swap(visited_, active_);
+  std::sort(visited_.begin(), visited_.end(), [](entity* x, entity* y) {
+    return x->rank_ < y->rank_;
+  });
+  for (auto entity : visited_)
+    entity->scheduled_ = false;
   // Allow entities to decide what to do on the next tick.
-  main_window_->before_tick();
-  for (auto& entity : entities_)
+  for (auto entity : visited_)
     entity->before_tick();
   // Run code for advancing in time on all entities.
-  main_window_->tick();
-  for (auto& entity : entities_)
+  for (auto entity : visited_)
     entity->tick();
   // Run all events that occurred during the tick.
+  deliver_messages();
   run_tick_events();
   // Trigger state transitions etc.
-  main_window_->after_tick();
-  for (auto& entity : entities_)
+  for (auto entity : visited_) {
     entity->after_tick();
-  // Increment time and emit updates.
+    if (entity->busy())
+      activate(entity);
+  }
+  visited_.clear();
+  // Increment time. The GUI thread renders updates in `render_frame`.
   ++time_;
-  if (!silent) {
-    for (auto& kvp : idle_times_)
-      emit idle_percentage_changed(kvp.first, idle_percentage(kvp.second));
-    emit average_global_idle_percentage_changed(average_global_idle_percentage());
-    emit average_global_latency_changed(average_global_latency());
+  if (checkpoint_pending_ && time_ >= cfg_.checkpoint_at)
+    write_checkpoint();
+}
+
+void environment::run_until(tick_time t) {
+  while (time_ < t) {
+    if (cfg_.skip_idle_ticks)
+      skip_idle_ticks(t);
+    if (time_ < t)
+      tick();
+  }
+}
+
+void environment::run_worker() {
+  using clock = std::chrono::steady_clock;
+  auto next_tick = clock::now();
+  std::unique_lock<std::mutex> guard{worker_mtx_};
+  for (;;) {
+    worker_paused_ = true;
+    worker_cv_.notify_all();
+    // Pause requests take precedence over manual ticks, which in turn take
+    // precedence over the tick rate.
+    auto manual = false;
+    for (;;) {
+      if (worker_shutdown_)
+        return;
+      if (pause_requests_ == 0) {
+        if (time_ < tick_target_) {
+          manual = true;
+          break;
+        }
+        if (tick_rate_ < 0)
+          break;
+        if (tick_rate_ > 0) {
+          auto now = clock::now();
+          if (now >= next_tick) {
+            // Drop ticks instead of catching up after falling behind.
+            auto period = std::chrono::microseconds(1000000 / tick_rate_);
+            next_tick = std::max(next_tick, now - period) + period;
+            break;
+          }
+          worker_cv_.wait_until(guard, next_tick);
+          continue;
+        }
+      }
+      worker_cv_.wait(guard);
+    }
+    worker_paused_ = false;
+    auto target = manual ? tick_target_ : time_ + 1;
+    guard.unlock();
+    if (manual && cfg_.skip_idle_ticks)
+      skip_idle_ticks(target);
+    if (time_ < target)
+      tick();
+    guard.lock();
   }
 }
 
+void environment::stop_worker() {
+  if (!worker_.joinable())
+    return;
+  critical_section(worker_mtx_, [&] { worker_shutdown_ = true; });
+  worker_cv_.notify_all();
+  worker_.join();
+}
+
+void environment::pause_worker() {
+  std::unique_lock<std::mutex> guard{worker_mtx_};
+  ++pause_requests_;
+  worker_cv_.wait(guard, [&] { return worker_paused_; });
+}
+
+void environment::resume_worker() {
+  critical_section(worker_mtx_, [&] { --pause_requests_; });
+  worker_cv_.notify_all();
+}
+
+void environment::skip_idle_ticks(tick_time limit) {
+  if (!quiescent())
+    return;
+  auto t = std::min(critical_section(network_queue_mtx_, [&] {
+                      return network_queue_.next_timestamp();
+                    }),
+                    critical_section(tick_events_mtx_, [&] {
+                      return tick_events_.next_timestamp();
+                    }));
+  t = std::min(t, limit);
+  if (checkpoint_pending_ && time_ < cfg_.checkpoint_at)
+    t = std::min(t, static_cast<tick_time>(cfg_.checkpoint_at));
+  // Entities report skipped ticks as idle time when visited again.
+  if (t > time_) {
+    time_ = t;
+    if (checkpoint_pending_ && time_ == cfg_.checkpoint_at)
+      write_checkpoint();
+  }
+}
+
+void environment::activate(entity* x) {
+  if (!x->scheduled_) {
+    x->scheduled_ = true;
+    active_.emplace_back(x);
+  }
+}
+
+void environment::index_entity(entity* x) {
+  in_flight_.resize(entities_.size());
+  entities_by_id_.insert(x->id(), x);
+  entities_by_handle_.emplace(x->sim()->id(), x);
+  trace_name(static_cast<int32_t>(x->rank()), x->id().toStdString());
+}
+
+int32_t environment::rank_of(const caf::actor_addr& x) const {
+  auto ptr = entity_by_handle(x);
+  return ptr != nullptr ? static_cast<int32_t>(ptr->rank()) : -1;
+}
+
+void environment::replay_diverged() {
+  if (time_ > replayer_->last_tick())
+    fprintf(stderr, "Replay log ended at tick %d, continuing without it\n",
+            static_cast<int>(replayer_->last_tick()));
+  else
+    fprintf(stderr, "Replay diverged from the log at tick %d, continuing "
+                    "without it\n", static_cast<int>(time_));
+  replayer_.reset();
+}
+
+void environment::save_state(checkpoint& x) {
+  flush_idle_times();
+  x.seed = seed_;
+  x.layout = layout_;
+  x.time = time_;
+  x.min_delay = min_delay_;
+  x.max_delay = max_delay_;
+  x.sections.clear();
+  state_writer out;
+  std::ostringstream rng_state;
+  rng_state << rng_;
+  out.put(rng_state.str());
+  // Neither queue guarantees an iteration order, so we sort all entries for
+  // a canonical representation. Tick events are opaque function objects.
+  std::vector<std::tuple<tick_time, int32_t, uint32_t>> msgs;
+  network_queue_.for_each([&](tick_time t, const in_flight_message& msg) {
+    msgs.emplace_back(t, rank_of(msg.receiver),
+                      msg.content ? msg.content->content().type_token() : 0);
+  });
+  std::sort(msgs.begin(), msgs.end());
+  out.put(msgs.size());
+  for (auto& msg : msgs) {
+    out.put(std::get<0>(msg));
+    out.put(std::get<1>(msg));
+    out.put(std::get<2>(msg));
+  }
+  std::vector<tick_time> events;
+  tick_events_.for_each([&](tick_time t, const tick_event_uptr&) {
+    events.emplace_back(t);
+  });
+  std::sort(events.begin(), events.end());
+  out.put(events.size());
+  for (auto t : events)
+    out.put(t);
+  save(out, global_latency_);
+  for (auto& e : entities_) {
+    auto ptr = e.get();
+    save(out, latency(ptr));
+    auto i = idle_times_.find(ptr);
+    out.put(i != idle_times_.end() ? i->second : 0);
+    auto& tracker = in_flight_[ptr->rank_];
+    out.put(tracker.size());
+    tracker.for_each([&](int id, tick_time t) {
+      out.put(id);
+      out.put(t);
+    });
+  }
+  x.sections.emplace_back("environment", out.take());
+  for (auto& e : entities_) {
+    state_writer entity_out;
+    e->save_state(entity_out);
+    x.sections.emplace_back(e->id().toStdString(), entity_out.take());
+  }
+}
+
+void environment::write_checkpoint() {
+  checkpoint_pending_ = false;
+  checkpoint x;
+  save_state(x);
+  if (!x.save(cfg_.checkpoint_file))
+    fprintf(stderr, "Cannot write checkpoint: %s\n",
+            cfg_.checkpoint_file.c_str());
+}
+
+void environment::apply_checkpoint_parameters() {
+  // Parameters edited while the checkpointed run was already under way still
+  // cause a mismatch, since the checkpoint only has their final values.
+  for (auto& e : entities_) {
+    auto section = verify_->find(e->id().toStdString());
+    if (section != nullptr) {
+      state_reader in{*section};
+      e->load_parameters(in);
+    }
+  }
+}
+
+QString environment::verify_checkpoint() {
+  auto expected = std::move(verify_);
+  run_until(expected->time);
+  checkpoint x;
+  save_state(x);
+  auto diff = x.first_difference(*expected);
+  if (!diff.empty())
+    return qstr("State at tick %1 differs from the checkpoint in section %2")
+           .arg(time_)
+           .arg(qstr(diff));
+  return {};
+}
+
+void environment::clear_entities() {
+  entity_memory_ = 0;
+  dialog_memory_ = 0;
+  num_dialogs_ = 0;
+  active_.clear();
+  entities_.clear();
+  entities_by_id_.clear();
+  entities_by_handle_.clear();
+  in_flight_.clear();
+  token_stats_.clear();
+  credit_policies_.clear();
+  edges_.clear();
+  layout_.clear();
+}
+
+void environment::flush_idle_times() {
+  for (auto& e : entities_)
+    e->report_idle_ticks(time_);
+}
+
 void environment::connect_slots(MainWindow* x) {
   // Connect main window events to environment slots.
-  connect(x, SIGNAL(tick_triggered()), SLOT(tick()));
+  connect(x, SIGNAL(tick_rate_changed(int)), SLOT(tick_rate(int)));
   connect(x, SIGNAL(manual_tick_triggered()), SLOT(manual_tick()));
+  connect(x, SIGNAL(frame_triggered()), SLOT(render_frame()));
   connect(this, SIGNAL(average_global_latency_changed(int)),
           x->avg_latency, SLOT(setValue(int)));
   connect(this, SIGNAL(average_global_idle_percentage_changed(double)),
           x->avg_sink_idle_time, SLOT(setValue(double)));
   connect(this, SIGNAL(average_global_latency_changed(int)),
           x->avg_latency, SLOT(setValue(int)));
+  if (verify_ != nullptr) {
+    x->min_delay->setValue(min_delay_);
+    x->max_delay->setValue(max_delay_);
+  }
+  connect(x->min_delay, SIGNAL(valueChanged(int)), SLOT(min_delay(int)));
+  connect(x->max_delay, SIGNAL(valueChanged(int)), SLOT(max_delay(int)));
+  min_delay(x->min_delay->value());
+  max_delay(x->max_delay->value());
+  tick_rate(x->ticks_per_second->value());
 }
 
 void environment::connect_slots(entity* x, bool is_sink) {
+  // Entities emit their signals on the simulation thread. Hence, we bypass
+  // the event loop of the GUI thread with direct connections.
   if (is_sink)
-    connect(x, SIGNAL(idling()), SLOT(sink_idling()));
-  connect(
-    x, SIGNAL(message_received(int, caf::strong_actor_ptr, caf::message)),
-    SLOT(entity_received_message(int, caf::strong_actor_ptr, caf::message)));
-  connect(x, SIGNAL(message_consumed(int)), SLOT(entity_consumed_message(int)));
+    connect(x, &entity::idling, this,
+            [=](int ticks) { sink_idling(x, ticks); }, Qt::DirectConnection);
+  connect(x, &entity::message_received, this,
+          [=](int id, caf::strong_actor_ptr from, caf::message content) {
+            entity_received_message(x, id, std::move(from),
+                                    std::move(content));
+          },
+          Qt::DirectConnection);
+  connect(x, &entity::message_consumed, this,
+          [=](int id) { entity_consumed_message(x, id); },
+          Qt::DirectConnection);
 }
 
 void environment::run_tick_events() {
-  using std::swap;
   tick_events events;
   critical_section(tick_events_mtx_, [&] {
-    auto i = tick_events_.find(time_);
-    if (i != tick_events_.end()) {
-      swap(events, i->second);
-      tick_events_.erase(i);
-    }
+    tick_events_.drain(time_, [&](tick_time, tick_event_uptr& x) {
+      events.emplace_back(std::move(x));
+    });
   });
   for (auto& event : events)
     event->run(time_);
 }
+
+void environment::deliver_messages() {
+  std::vector<in_flight_message> msgs;
+  critical_section(network_queue_mtx_, [&] {
+    network_queue_.drain(time_, [&](tick_time, in_flight_message& x) {
+      msgs.emplace_back(std::move(x));
+    });
+  });
+  for (auto& msg : msgs)
+    msg.receiver->enqueue(std::move(msg.content), nullptr);
+}
@@ -0,0 +1,102 @@
+// The ucontext API is deprecated on macOS and requires _XOPEN_SOURCE.
+#if defined(__APPLE__) && !defined(_XOPEN_SOURCE)
+#define _XOPEN_SOURCE 600
+#endif
+
+#include "fiber.hpp"
+
+#include <vector>
+#include <cassert>
+#include <stdexcept>
+
+#include <ucontext.h>
+
+namespace {
+
+using stack_ptr = std::unique_ptr<char[]>;
+
+/// Recycles fiber stacks to avoid allocating one per mailbox element.
+class stack_pool {
+public:
+  stack_ptr take() {
+    if (free_.empty())
+      return stack_ptr{new char[fiber::stack_size]};
+    auto result = std::move(free_.back());
+    free_.pop_back();
+    return result;
+  }
+
+  void put(stack_ptr x) {
+    free_.emplace_back(std::move(x));
+  }
+
+private:
+  std::vector<stack_ptr> free_;
+};
+
+thread_local stack_pool pool;
+
+/// Passes the fiber to `fiber::trampoline`, since `makecontext` only portably
+/// supports `int` arguments.
+thread_local fiber* starting_fiber = nullptr;
+
+} // namespace <anonymous>
+
+struct fiber::context {
+  ucontext_t self;
+  ucontext_t caller;
+  stack_ptr stack;
+};
+
+fiber::fiber(std::function<void()> f)
+  : f_(std::move(f)),
+    ctx_(new context),
+    started_(false),
+    done_(false) {
+  ctx_->stack = pool.take();
+  if (getcontext(&ctx_->self) != 0)
+    throw std::runtime_error("getcontext failed");
+  ctx_->self.uc_stack.ss_sp = ctx_->stack.get();
+  ctx_->self.uc_stack.ss_size = stack_size;
+  // Returning from the trampoline continues at the last call to resume().
+  ctx_->self.uc_link = &ctx_->caller;
+  makecontext(&ctx_->self, trampoline, 0);
+}
+
+fiber::~fiber() {
+  // Destroying a suspended fiber skips destructors of objects on its stack.
+  assert(!started_ || done_);
+  pool.put(std::move(ctx_->stack));
+}
+
+bool fiber::resume() {
+  if (done_)
+    return true;
+  if (!started_) {
+    started_ = true;
+    starting_fiber = this;
+  }
+  swapcontext(&ctx_->caller, &ctx_->self);
+  if (eptr_) {
+    auto eptr = std::move(eptr_);
+    eptr_ = nullptr;
+    std::rethrow_exception(eptr);
+  }
+  return done_;
+}
+
+void fiber::yield() {
+  swapcontext(&ctx_->self, &ctx_->caller);
+}
+
+void fiber::trampoline() {
+  auto self = starting_fiber;
+  starting_fiber = nullptr;
+  // Exceptions must not cross context boundaries.
+  try {
+    self->f_();
+  } catch (...) {
+    self->eptr_ = std::current_exception();
+  }
+  self->done_ = true;
+}
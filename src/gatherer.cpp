@@ -1,10 +1,15 @@
 #include "gatherer.hpp"
 
+#include <cmath>
+#include <algorithm>
+
 #include "caf/all.hpp"
 
 #include "entity.hpp"
+#include "checkpoint.hpp"
 #include "environment.hpp"
 #include "scatterer.hpp"
+#include "trace.hpp"
 
 using namespace caf;
 
@@ -12,69 +17,137 @@ gatherer::~gatherer() {
   // nop
 }
 
-void gatherer::assign_credit(long ) {
-  // TODO: implement me
+void gatherer::init() {
+  auto& cfg = parent_->env()->cfg();
+  credit_interval_ = cfg.cycle_duration;
+  initial_credit_ = static_cast<long>(cfg.min_tokens);
+  min_credit_ = cfg.min_batch_size;
+}
+
+void gatherer::assign_credit(long downstream_capacity) {
+  TRACE_INFO(trace_event::assign_credit, parent_->rank(),
+             parent_->env()->timestamp(), downstream_capacity);
+  CAF_LOG_TRACE(CAF_ARG(downstream_capacity));
+  if (assignment_vec_.empty())
+    return;
+  // Never promise more elements than our downstream can take.
+  auto share = downstream_capacity / static_cast<long>(assignment_vec_.size());
+  for (auto& kvp : assignment_vec_) {
+    auto credit = std::min(desired_credit(kvp.first), share);
+    if (credit > kvp.first->assigned_credit)
+      kvp.second = credit - kvp.first->assigned_credit;
+    else
+      kvp.second = 0;
+  }
+  emit_credits();
 }
 
 long gatherer::initial_credit(long downstream_capacity, path_ptr x) {
-  // TODO: implement me
-  CAF_IGNORE_UNUSED(downstream_capacity);
-  CAF_IGNORE_UNUSED(x);
-  return 0;
+  // Grant at least a minimal batch. Otherwise, the stream stalls if the
+  // downstream capacity is still unknown.
+  return std::max(std::min(downstream_capacity, desired_credit(x)),
+                  min_credit_);
+}
+
+bool gatherer::remove_path(const stream_id& sid, const actor_addr& x,
+                           error reason, bool silent) {
+  // Drop the controller state before CAF destroys the path. Otherwise, a new
+  // path at the same address would inherit it.
+  auto path = find(sid, x);
+  if (path != nullptr)
+    rate_states_.erase(path);
+  return super::remove_path(sid, x, std::move(reason), silent);
+}
+
+bool gatherer::contains(inbound_path* x) const {
+  return std::any_of(paths_.begin(), paths_.end(),
+                     [=](const path_uptr& y) { return y.get() == x; });
+}
+
+void gatherer::batch_completed(inbound_path* from, long xs_size,
+                               tick_time enqueue_time, tick_time start_time,
+                               tick_time end_time) {
+  TRACE_INFO(trace_event::batch_completed, parent_->rank(),
+             parent_->env()->timestamp(), xs_size, start_time, end_time);
+  CAF_ASSERT(xs_size > 0);
+  CAF_ASSERT(end_time >= start_time);
+  auto scheduling_delay = std::max(start_time - enqueue_time, 0);
+  update_rate(from, end_time, static_cast<size_t>(xs_size),
+              end_time - start_time, scheduling_delay);
 }
 
-void gatherer::batch_completed(inbound_path* from, size_t num_elements, int64_t) {
-  auto t = parent_->env()->timestamp();
-  auto wait_delay = 5; // waitDelay <- batchCompleted.batchInfo.schedulingDelay
-  auto work_delay = 5; // processingEndTime - processingStartTime;
-  update_rate(from, t, num_elements, work_delay, wait_delay);
+double gatherer::rate(inbound_path* x) const {
+  auto i = rate_states_.find(x);
+  return i != rate_states_.end() ? i->second.last_rate_ : 0.;
 }
 
-void gatherer::update_rate(inbound_path* from, tick_duration time,
+void gatherer::save_state(state_writer& out) const {
+  out.put(credit_interval_);
+  out.put(initial_credit_);
+  out.put(min_credit_);
+  // The rate states have no canonical order, but the paths do.
+  for (long path_id = 0; path_id < num_paths(); ++path_id) {
+    auto i = rate_states_.find(path_at(static_cast<size_t>(path_id)));
+    out.put(i != rate_states_.end());
+    if (i != rate_states_.end()) {
+      out.put(i->second.last_time_);
+      out.put(i->second.last_rate_);
+      out.put(i->second.last_err_);
+    }
+  }
+}
+
+long gatherer::desired_credit(inbound_path* x) const {
+  auto i = rate_states_.find(x);
+  if (i == rate_states_.end())
+    return initial_credit_;
+  auto credit = lround(i->second.last_rate_ * to_seconds(credit_interval_));
+  return std::max(credit, min_credit_);
+}
+
+void gatherer::update_rate(inbound_path* from, tick_time time,
                            size_t num_elements, tick_duration processing_delay,
                            tick_duration scheduling_delay) {
-  // In elements/tick.
-  auto processing_rate = static_cast<double>(num_elements) / processing_delay;
+  if (num_elements == 0 || processing_delay <= 0)
+    return;
+  // In elements/second.
+  auto processing_rate = num_elements / to_seconds(processing_delay);
   auto i = rate_states_.find(from);
   if (i == rate_states_.end()) {
-    rate_states_.emplace(
-      from,
-      rate_state{time, static_cast<tick_duration>(processing_rate), 0., 0});
+    // Start at the measured rate.
+    rate_states_.emplace(from, rate_state{time, processing_rate, 0.});
     return;
   }
   auto& rs = i->second;
-  if (time > rs.last_time_ && num_elements > 0 && processing_delay > 0) {
-    // in seconds, should be close to batchDuration
-    auto delay_since_update = time - rs.last_time_;
-
-
-    // In our system `error` is the difference between the desired rate and the
-    // measured rate based on the last batch information. We consider the
-    // desired rate to be last rate, which is what this estimator calculated
-    // for the previous batch. In elements/tick.
-    auto err = rs.last_rate_ - processing_rate;
-    // The error integral, based on schedulingDelay as an indicator for
-    // accumulated errors. A scheduling delay s corresponds to s *
-    // processingRate overflowing elements. Those are elements that couldn't
-    // be processed in previous batches, leading to this delay. In the
-    // following, we assume the processingRate didn't change too much. From
-    // the number of overflowing elements we can calculate the rate at which
-    // they would be processed by dividing it by the batch interval. This
-    // rate is our "historical" error, or integral part, since if we
-    // subtracted this rate from the previous "calculated rate", there
-    // wouldn't have been any overflowing elements, and the scheduling delay
-    // would have been zero. In elements/tick.
-    auto historical_err = static_cast<double>(scheduling_delay)
-                          * processing_rate / rs.batch_interval_;
-    // In elements/(tick ^ 2).
-    auto d_err = to_seconds((err - rs.last_err_) / delay_since_update);
-    auto new_rate =
-      std::max(rs.last_rate_ - proportional_ * err - integral_ * historical_err
-                 - derivative_ * d_err,
-               min_rate_);
-    rs.last_time_ = time;
-    rs.last_rate_ = new_rate;
-    rs.last_err_ = err;
-  }
+  if (time <= rs.last_time_)
+    return;
+  // In seconds, should be close to the credit interval.
+  auto delay_since_update = to_seconds(time - rs.last_time_);
+  // In our system `error` is the difference between the desired rate and the
+  // measured rate based on the last batch information. We consider the
+  // desired rate to be last rate, which is what this estimator calculated
+  // for the previous batch. In elements/second.
+  auto err = rs.last_rate_ - processing_rate;
+  // The error integral, based on schedulingDelay as an indicator for
+  // accumulated errors. A scheduling delay s corresponds to s *
+  // processingRate overflowing elements. Those are elements that couldn't
+  // be processed in previous batches, leading to this delay. In the
+  // following, we assume the processingRate didn't change too much. From
+  // the number of overflowing elements we can calculate the rate at which
+  // they would be processed by dividing it by the credit interval. This
+  // rate is our "historical" error, or integral part, since if we
+  // subtracted this rate from the previous "calculated rate", there
+  // wouldn't have been any overflowing elements, and the scheduling delay
+  // would have been zero. In elements/second.
+  auto historical_err = to_seconds(scheduling_delay) * processing_rate
+                        / to_seconds(credit_interval_);
+  // In elements/(second ^ 2).
+  auto d_err = (err - rs.last_err_) / delay_since_update;
+  auto new_rate =
+    std::max(rs.last_rate_ - proportional_ * err - integral_ * historical_err
+               - derivative_ * d_err,
+             min_rate_);
+  rs.last_time_ = time;
+  rs.last_rate_ = new_rate;
+  rs.last_err_ = err;
 }
-
@@ -0,0 +1,82 @@
+#include "latency_stats.hpp"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+namespace {
+
+constexpr size_t sub_bucket_bits = 5;
+
+constexpr size_t sub_buckets = size_t{1} << sub_bucket_bits;
+
+} // namespace <anonymous>
+
+latency_stats::latency_stats()
+  : count_(0),
+    sum_(0),
+    min_(std::numeric_limits<tick_duration>::max()),
+    max_(0) {
+  // nop
+}
+
+void latency_stats::record(tick_duration x) {
+  if (x < 0)
+    x = 0;
+  ++count_;
+  sum_ += x;
+  min_ = std::min(min_, x);
+  max_ = std::max(max_, x);
+  auto i = bucket_of(x);
+  if (i >= buckets_.size())
+    buckets_.resize(i + 1);
+  ++buckets_[i];
+}
+
+void latency_stats::reset() {
+  count_ = 0;
+  sum_ = 0;
+  min_ = std::numeric_limits<tick_duration>::max();
+  max_ = 0;
+  buckets_.clear();
+}
+
+tick_duration latency_stats::mean() const {
+  if (count_ == 0)
+    return 0;
+  return static_cast<tick_duration>(sum_ / static_cast<int64_t>(count_));
+}
+
+tick_duration latency_stats::percentile(double q) const {
+  if (count_ == 0)
+    return 0;
+  auto target = static_cast<uint64_t>(std::ceil(q * count_));
+  target = std::max(target, uint64_t{1});
+  uint64_t seen = 0;
+  for (size_t i = 0; i < buckets_.size(); ++i) {
+    seen += buckets_[i];
+    if (seen >= target)
+      return std::min(std::max(highest_value_of(i), min()), max_);
+  }
+  return max_;
+}
+
+size_t latency_stats::bucket_of(tick_duration x) {
+  auto v = static_cast<uint32_t>(x);
+  // Values below 2 * sub_buckets map to their own bucket.
+  if (v < 2 * sub_buckets)
+    return v;
+  size_t msb = 0;
+  for (auto y = v; y > 1; y >>= 1)
+    ++msb;
+  auto shift = msb - sub_bucket_bits;
+  return sub_buckets * shift + (v >> shift);
+}
+
+tick_duration latency_stats::highest_value_of(size_t bucket) {
+  if (bucket < 2 * sub_buckets)
+    return static_cast<tick_duration>(bucket);
+  auto shift = bucket / sub_buckets - 1;
+  auto sub = bucket - sub_buckets * shift;
+  return static_cast<tick_duration>(((sub + 1) << shift) - 1);
+}
@@ -0,0 +1,97 @@
+#include "layered_layout.hpp"
+
+#include <algorithm>
+
+namespace {
+
+using adjacency = std::vector<std::vector<size_t>>;
+
+/// Sorts `layer` by the average position of the neighbors of each node.
+/// Nodes without neighbors keep their current position.
+void sort_by_barycenter(std::vector<size_t>& layer, const adjacency& neighbors,
+                        const std::vector<double>& pos,
+                        std::vector<double>& keys) {
+  for (auto x : layer) {
+    auto& xs = neighbors[x];
+    if (xs.empty()) {
+      keys[x] = pos[x];
+      continue;
+    }
+    double sum = 0;
+    for (auto y : xs)
+      sum += pos[y];
+    keys[x] = sum / xs.size();
+  }
+  std::stable_sort(layer.begin(), layer.end(), [&](size_t x, size_t y) {
+    return keys[x] < keys[y];
+  });
+}
+
+/// Stores the centered position of each node in `layer` in `pos`.
+void assign_positions(const std::vector<size_t>& layer,
+                      std::vector<double>& pos) {
+  auto offset = (static_cast<double>(layer.size()) - 1) / 2;
+  for (size_t i = 0; i < layer.size(); ++i)
+    pos[layer[i]] = static_cast<double>(i) - offset;
+}
+
+} // namespace <anonymous>
+
+std::vector<layer_position>
+layered_layout(size_t num_nodes,
+               const std::vector<std::pair<size_t, size_t>>& edges,
+               int sweeps) {
+  adjacency preds(num_nodes);
+  adjacency succs(num_nodes);
+  std::vector<size_t> in_degree(num_nodes, 0);
+  for (auto& e : edges) {
+    succs[e.first].emplace_back(e.second);
+    preds[e.second].emplace_back(e.first);
+    ++in_degree[e.second];
+  }
+  // Assign layers by longest path in topological order (Kahn's algorithm).
+  std::vector<size_t> rank(num_nodes, 0);
+  std::vector<size_t> queue;
+  queue.reserve(num_nodes);
+  for (size_t x = 0; x < num_nodes; ++x)
+    if (in_degree[x] == 0)
+      queue.emplace_back(x);
+  for (size_t i = 0; i < queue.size(); ++i) {
+    auto x = queue[i];
+    for (auto y : succs[x]) {
+      rank[y] = std::max(rank[y], rank[x] + 1);
+      if (--in_degree[y] == 0)
+        queue.emplace_back(y);
+    }
+  }
+  // Nodes on a cycle never reach an in-degree of 0.
+  for (size_t x = 0; x < num_nodes; ++x)
+    if (in_degree[x] != 0)
+      rank[x] = 0;
+  size_t num_layers = 0;
+  for (auto r : rank)
+    num_layers = std::max(num_layers, r + 1);
+  std::vector<std::vector<size_t>> layers(num_layers);
+  for (size_t x = 0; x < num_nodes; ++x)
+    layers[rank[x]].emplace_back(x);
+  // Reduce crossings with alternating barycenter sweeps.
+  std::vector<double> pos(num_nodes, 0);
+  std::vector<double> keys(num_nodes, 0);
+  for (auto& layer : layers)
+    assign_positions(layer, pos);
+  for (int i = 0; i < sweeps; ++i) {
+    for (size_t l = 1; l < num_layers; ++l) {
+      sort_by_barycenter(layers[l], preds, pos, keys);
+      assign_positions(layers[l], pos);
+    }
+    for (size_t l = num_layers; l-- > 1;) {
+      sort_by_barycenter(layers[l - 1], succs, pos, keys);
+      assign_positions(layers[l - 1], pos);
+    }
+  }
+  std::vector<layer_position> result(num_nodes);
+  for (size_t l = 0; l < num_layers; ++l)
+    for (size_t i = 0; i < layers[l].size(); ++i)
+      result[layers[l][i]] = layer_position{l, i, layers[l].size()};
+  return result;
+}
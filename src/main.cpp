@@ -17,6 +17,8 @@
  * http://www.boost.org/LICENSE_1_0.txt.                                      *
  ******************************************************************************/
 
+#include <cstdlib>
+
 #include <QVector>
 #include <QMetaType>
 
@@ -29,6 +31,6 @@
 int main(int argc, char** argv) {
   qRegisterMetaType<QVector<int>>("QVector<int>");
   environment env{argc, argv};
-  env.run();
+  return env.run() ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
@@ -31,20 +31,31 @@
 #include "stage.hpp"
 #include "node.hpp"
 #include "edge.hpp"
+#include "qstr.hpp"
 #include "environment.hpp"
 
+namespace {
+
+// Number of snapshots per second rendered by the GUI thread, independent of
+// how fast the simulation advances.
+constexpr int frames_per_second = 30;
+
+} // namespace <anonymous>
+
 MainWindow::MainWindow(environment* env, QWidget *parent) :
     QMainWindow(parent),
     env_(env),
-    timer(new QTimer(this)) {
+    frame_timer(new QTimer(this)) {
   // UI and signal/slot setup
   setupUi(this);
   connect(ticks_per_second, SIGNAL(valueChanged(int)),
           this, SLOT(manual_tick_count_changed(int)));
+  connect(as_fast_as_possible, SIGNAL(toggled(bool)),
+          this, SLOT(as_fast_as_possible_toggled(bool)));
   connect(manual_tick, SIGNAL(pressed()),
           this, SIGNAL(manual_tick_triggered()));
-  connect(timer, SIGNAL(timeout()),
-          this, SIGNAL(tick_triggered()));
+  connect(frame_timer, SIGNAL(timeout()),
+          this, SIGNAL(frame_triggered()));
   load_default_view();
 }
 
@@ -53,125 +64,38 @@ MainWindow::~MainWindow() {
 }
 
 void MainWindow::start() {
-  // nop
-}
-
-void MainWindow::before_tick() {
-  // nop
-}
-
-void MainWindow::tick() {
-  ticks->setValue(ticks->value() + 1);
+  frame_timer->start(1000 / frames_per_second);
 }
 
-void MainWindow::after_tick() {
-  // nop
+void MainWindow::render() {
+  // Time advances by many ticks per frame.
+  ticks->setValue(env_->timestamp());
 }
 
-void MainWindow::tock() {
-  // nop
+void MainWindow::manual_tick_count_changed(int x) {
+  if (as_fast_as_possible->isChecked())
+    return;
+  manual_tick->setEnabled(x == 0);
+  emit tick_rate_changed(x);
 }
 
-void MainWindow::manual_tick_count_changed(int x) {
-  if (x == 0) {
-    manual_tick->setEnabled(true);
-    timer->stop();
-  } else {
-    manual_tick->setEnabled(false);
-    timer->start(1000 / x);
-  }
+void MainWindow::as_fast_as_possible_toggled(bool x) {
+  ticks_per_second->setEnabled(!x);
+  manual_tick->setEnabled(!x && ticks_per_second->value() == 0);
+  emit tick_rate_changed(x ? -1 : ticks_per_second->value());
 }
 
 void MainWindow::load_layout(QTextStream& in) {
   // Clean slate.
   setUpdatesEnabled(false);
   qDeleteAll(dag->items());
-  // Helper functions for error handling.
-  auto warn = [&](QString text) {
+  // Let the environment create all entities.
+  auto err = env_->load_layout(this, in.readLine());
+  if (!err.isEmpty()) {
     setUpdatesEnabled(true);
-    QMessageBox::warning(this, "Cannot load layout", text);
-  };
-  auto warn_at_cell = [&](QString text, int row, int col) {
-    text += " in cell (";
-    text += QString::number(row);
-    text += ", ";
-    text += QString::number(col);
-    text += ")";
-    warn(text);
-  };
-  auto line = in.readLine();
-  // We expect a line like "src1,src2;snk1,snk1".
-  // ',' separates columns and ';' separates rows.
-  auto rows = line.split(";");
-  if (rows.empty()) {
-    warn("No scheme to load in first line");
+    QMessageBox::warning(this, "Cannot load layout", err);
     return;
   }
-  QVector<QStringList> input_matrix;
-  for (auto& row : rows)
-    input_matrix.append(row.split(","));
-  // Make sure all columns are of equal size.
-  auto height = input_matrix.size();
-  auto width = input_matrix[0].size();
-  if (width < 2) {
-      warn("Layout contains only a single column");
-      return;
-  }
-  for (auto& row : input_matrix)
-    if (row.size() != width) {
-      warn("Columns are not of equal size");
-      return;
-    }
-  std::vector<std::vector<entity*>> matrix;
-  matrix.resize(height);
-  for (auto& matrix_row : matrix)
-    matrix_row.resize(width);
-  // Maps source IDs to sink IDs.
-  std::map<source*, entity*> edges;
-  // Singleton-like access (with lazy init) to loaded entites.
-  // Stores the last source (or stage) seen on a given row.
-  std::vector<entity*> row_backtrace;
-  row_backtrace.resize(height);
-  // Parse the input matrix to create all entities and to extract dependencies.
-  for (auto row = 0; row < height; ++row) {
-    // Keep track of last seen source.
-    source* bt = nullptr;
-    for (auto col = 0; col < width; ++col) {
-      auto& cell_text = input_matrix[row][col];
-      if (cell_text.size() < 4 && cell_text != "-") {
-        warn_at_cell("Invalid text \"" + cell_text + "\"", row, col);
-        return;
-      } else if (cell_text.startsWith("src")) {
-        if (bt != nullptr) {
-          warn_at_cell("Misplaced source", row, col);
-          return;
-        }
-        bt = env_->get_entity<source>(this, cell_text);
-        matrix[row][col] = bt;
-      } else if (cell_text.startsWith("stg")) {
-        if (bt == nullptr) {
-          warn_at_cell("Misplaced stage", row, col);
-          return;
-        };
-        auto ptr = env_->get_entity<stage>(this, cell_text);
-        edges.emplace(bt, ptr);
-        bt = ptr;
-        matrix[row][col] = ptr;
-      } else if (cell_text.startsWith("snk")) {
-        if (bt == nullptr) {
-          warn_at_cell("Misplaced sink", row, col);
-          return;
-        };
-        auto ptr = env_->get_entity<sink>(this, cell_text);
-        edges.emplace(bt, ptr);
-        bt = nullptr;
-        matrix[row][col] = ptr;
-      } else if (cell_text != "-") {
-        warn_at_cell("Invalid text \"" + cell_text + "\"", row, col);
-        return;
-      }
-    }
-  }
   std::map<entity*, node*> nodes;
   auto scene = dag->scene();
   // Create graphics view nodes.
@@ -180,19 +104,19 @@ void MainWindow::load_layout(QTextStream& in) {
     nodes.emplace(x.get(), ptr);
     scene->addItem(ptr); // Scene takes ownership of ptr.
   }
-  // Create graphics view edges and connect sources to sinks.
-  for (auto& kvp : edges) {
-    kvp.first->add_consumer(kvp.second->handle());
+  // Create graphics view edges.
+  for (auto& kvp : env_->edges())
     scene->addItem(new edge(nodes[kvp.first], nodes[kvp.second]));
-  }
-  dag->shuffle();
+  dag->mode(env_->cfg().graph_layout == "force" ? dag_widget::force_directed
+                                                : dag_widget::layered);
+  dag->arrange();
   // Done.
   setUpdatesEnabled(true);
 }
 
 void MainWindow::load_default_view() {
   //QString txt = QStringLiteral("src1,stg1,snk1;src2,stg1,snk1;src3,-,snk1");
-  QString txt = QStringLiteral("src1,snk1");
+  QString txt = qstr(env_->layout());
   QTextStream in(&txt);
   load_layout(in);
 }
@@ -0,0 +1,64 @@
+#include "message_tracker.hpp"
+
+constexpr tick_time message_tracker::none;
+
+message_tracker::message_tracker() : first_id_(0), size_(0) {
+  // nop
+}
+
+bool message_tracker::add(int id, tick_time t) {
+  if (slots_.empty()) {
+    first_id_ = id;
+    slots_.emplace_back(t);
+    ++size_;
+    return true;
+  }
+  // Messages may arrive out of order, so we grow the window in both
+  // directions.
+  if (id < first_id_) {
+    slots_.insert(slots_.begin(), static_cast<size_t>(first_id_ - id), none);
+    first_id_ = id;
+  }
+  auto i = static_cast<size_t>(id - first_id_);
+  if (i >= slots_.size())
+    slots_.resize(i + 1, none);
+  if (slots_[i] != none)
+    return false;
+  slots_[i] = t;
+  ++size_;
+  return true;
+}
+
+bool message_tracker::find(int id, tick_time& t) const {
+  if (id < first_id_)
+    return false;
+  auto i = static_cast<size_t>(id - first_id_);
+  if (i >= slots_.size() || slots_[i] == none)
+    return false;
+  t = slots_[i];
+  return true;
+}
+
+bool message_tracker::remove(int id, tick_time& t) {
+  if (id < first_id_)
+    return false;
+  auto i = static_cast<size_t>(id - first_id_);
+  if (i >= slots_.size() || slots_[i] == none)
+    return false;
+  t = slots_[i];
+  slots_[i] = none;
+  --size_;
+  // Shrink the window to the oldest and newest tracked messages.
+  while (!slots_.empty() && slots_.front() == none) {
+    slots_.pop_front();
+    ++first_id_;
+  }
+  while (!slots_.empty() && slots_.back() == none)
+    slots_.pop_back();
+  return true;
+}
+
+void message_tracker::clear() {
+  slots_.clear();
+  size_ = 0;
+}
@@ -12,6 +12,7 @@
 #include "edge.hpp"
 #include "qstr.hpp"
 #include "entity.hpp"
+#include "quadtree.hpp"
 #include "dag_widget.hpp"
 
 node::node(class entity* parent_entity, dag_widget* parent_widget)
@@ -34,27 +35,16 @@ void node::add(edge* x) {
   x->adjust();
 }
 
-void node::calculateForces() {
+void node::calculateForces(const quadtree& nodes) {
   if (!scene() || scene()->mouseGrabberItem() == this) {
     new_pos_ = pos();
     return;
   }
-  // Sum up all forces pushing this item away.
-  qreal xvel = 0;
-  qreal yvel = 0;
-  for (auto item : scene()->items()) {
-    auto ptr = qgraphicsitem_cast<node*>(item);
-    if (!ptr)
-      continue;
-    QPointF vec = mapToItem(ptr, 0, 0);
-    qreal dx = vec.x();
-    qreal dy = vec.y();
-    double l = 2.0 * (dx * dx + dy * dy);
-    if (l > 0) {
-      xvel += (dx * 150.0) / l;
-      yvel += (dy * 150.0) / l;
-    }
-  }
+  // Sum up all forces pushing this item away. The quadtree treats distant
+  // groups of nodes as a single node.
+  auto push = nodes.repulsion(pos(), 75.0);
+  qreal xvel = push.x();
+  qreal yvel = push.y();
   // Subtract all forces pulling items together.
   double weight = (edges_.size() + 1) * 10.0;
   for (auto ptr : edges_) {
@@ -97,6 +87,15 @@ QPainterPath node::shape() const {
 
 void node::paint(QPainter* painter, const QStyleOptionGraphicsItem* option,
                  QWidget*) {
+  // Draw a flat dot without text when zoomed out.
+  auto lod = option->levelOfDetailFromTransform(painter->worldTransform());
+  if (lod < dag_widget::min_detail) {
+    painter->setPen(Qt::NoPen);
+    painter->setBrush(widget_->selected() == this ? Qt::darkGreen
+                                                  : Qt::darkYellow);
+    painter->drawEllipse(QRectF{x(), y(), width(), height()});
+    return;
+  }
   // Draw shadow.
   painter->setPen(Qt::NoPen);
   painter->setBrush(Qt::darkGray);
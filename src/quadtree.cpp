@@ -0,0 +1,134 @@
+#include "quadtree.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+namespace {
+
+// Points closer than this end up in the same leaf.
+constexpr int max_depth = 24;
+
+} // namespace <anonymous>
+
+quadtree::quadtree(qreal theta) : theta_(theta) {
+  // nop
+}
+
+void quadtree::build(const std::vector<QPointF>& xs) {
+  cells_.clear();
+  if (xs.empty())
+    return;
+  // Compute a square root area that contains all points.
+  auto x0 = xs.front().x();
+  auto x1 = x0;
+  auto y0 = xs.front().y();
+  auto y1 = y0;
+  for (auto& p : xs) {
+    x0 = std::min(x0, p.x());
+    x1 = std::max(x1, p.x());
+    y0 = std::min(y0, p.y());
+    y1 = std::max(y1, p.y());
+  }
+  cells_.reserve(xs.size() * 2);
+  cell root;
+  root.cx = (x0 + x1) / 2;
+  root.cy = (y0 + y1) / 2;
+  root.half = std::max(std::max(x1 - x0, y1 - y0) / 2, qreal{1});
+  root.mx = 0;
+  root.my = 0;
+  root.mass = 0;
+  std::fill(std::begin(root.children), std::end(root.children), 0);
+  cells_.emplace_back(root);
+  for (auto& p : xs)
+    insert(0, p.x(), p.y(), 0);
+}
+
+QPointF quadtree::repulsion(QPointF p, qreal strength) const {
+  qreal fx = 0;
+  qreal fy = 0;
+  if (cells_.empty())
+    return {fx, fy};
+  auto theta2 = theta_ * theta_;
+  uint32_t stack[max_depth * 4 + 4];
+  size_t top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    auto& c = cells_[stack[--top]];
+    auto dx = p.x() - c.mx;
+    auto dy = p.y() - c.my;
+    auto dist2 = dx * dx + dy * dy;
+    auto leaf = c.children[0] == 0 && c.children[1] == 0
+                && c.children[2] == 0 && c.children[3] == 0;
+    auto width = 2 * c.half;
+    if (leaf || width * width < theta2 * dist2) {
+      if (dist2 > 0) {
+        fx += c.mass * strength * dx / dist2;
+        fy += c.mass * strength * dy / dist2;
+      }
+      continue;
+    }
+    for (auto child : c.children)
+      if (child != 0)
+        stack[top++] = child;
+  }
+  return {fx, fy};
+}
+
+void quadtree::insert(uint32_t pos, qreal x, qreal y, int depth) {
+  for (;;) {
+    auto& c = cells_[pos];
+    auto leaf = c.children[0] == 0 && c.children[1] == 0
+                && c.children[2] == 0 && c.children[3] == 0;
+    if (leaf && (c.mass == 0 || depth >= max_depth
+                 || (c.mx == x && c.my == y))) {
+      // Empty leaf or a point that we cannot separate from the others.
+      c.mx = (c.mx * c.mass + x) / (c.mass + 1);
+      c.my = (c.my * c.mass + y) / (c.mass + 1);
+      c.mass += 1;
+      return;
+    }
+    if (leaf) {
+      // Push the point(s) of this leaf down into a new child.
+      auto mass = c.mass;
+      auto mx = c.mx;
+      auto my = c.my;
+      auto child = make_child(pos, mx, my);
+      auto& moved = cells_[child];
+      moved.mx = mx;
+      moved.my = my;
+      moved.mass = mass;
+    }
+    // `make_child` may have invalidated `c`.
+    auto& parent = cells_[pos];
+    parent.mx = (parent.mx * parent.mass + x) / (parent.mass + 1);
+    parent.my = (parent.my * parent.mass + y) / (parent.mass + 1);
+    parent.mass += 1;
+    auto q = quadrant(parent, x, y);
+    auto next = parent.children[q];
+    if (next == 0)
+      next = make_child(pos, x, y);
+    pos = next;
+    ++depth;
+  }
+}
+
+uint32_t quadtree::make_child(uint32_t pos, qreal x, qreal y) {
+  auto q = quadrant(cells_[pos], x, y);
+  auto& parent = cells_[pos];
+  cell child;
+  child.half = parent.half / 2;
+  child.cx = parent.cx + ((q & 1) ? child.half : -child.half);
+  child.cy = parent.cy + ((q & 2) ? child.half : -child.half);
+  child.mx = 0;
+  child.my = 0;
+  child.mass = 0;
+  std::fill(std::begin(child.children), std::end(child.children), 0);
+  auto result = static_cast<uint32_t>(cells_.size());
+  parent.children[q] = result;
+  cells_.emplace_back(child);
+  return result;
+}
+
+int quadtree::quadrant(const cell& c, qreal x, qreal y) {
+  return (x >= c.cx ? 1 : 0) | (y >= c.cy ? 2 : 0);
+}
@@ -3,3 +3,11 @@
 rate_controlled_sink::~rate_controlled_sink() {
   // nop
 }
+
+void rate_controlled_sink::batch_sent(tick_time tstamp, size_t num_elements) {
+  send_rate_.add(tstamp, num_elements);
+}
+
+double rate_controlled_sink::last_rate(tick_time tstamp) {
+  return send_rate_.rate(tstamp);
+}
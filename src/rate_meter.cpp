@@ -0,0 +1,73 @@
+#include "rate_meter.hpp"
+
+#include <cmath>
+#include <cassert>
+
+// -- rate_meter ---------------------------------------------------------------
+
+rate_meter::rate_meter(tick_duration window, size_t capacity)
+    : window_(window),
+      buf_(capacity > 0 ? capacity : 1),
+      first_(0),
+      size_(0),
+      sum_(0) {
+  // nop
+}
+
+void rate_meter::add(tick_time tstamp, size_t num_elements) {
+  assert(size_ == 0 || buf_[(first_ + size_ - 1) % buf_.size()].first <= tstamp);
+  expire(tstamp - window_);
+  sum_ += num_elements;
+  // Merge batches with the same timestamp into a single sample.
+  if (size_ > 0) {
+    auto& last = buf_[(first_ + size_ - 1) % buf_.size()];
+    if (last.first == tstamp) {
+      last.second += num_elements;
+      return;
+    }
+  }
+  if (size_ == buf_.size())
+    pop();
+  buf_[(first_ + size_) % buf_.size()] = sample{tstamp, num_elements};
+  ++size_;
+}
+
+size_t rate_meter::count(tick_time tstamp) {
+  expire(tstamp - window_);
+  return sum_;
+}
+
+double rate_meter::rate(tick_time tstamp) {
+  return count(tstamp) / to_seconds(window_);
+}
+
+void rate_meter::expire(tick_time t0) {
+  while (size_ > 0 && buf_[first_].first <= t0)
+    pop();
+}
+
+void rate_meter::pop() {
+  sum_ -= buf_[first_].second;
+  first_ = (first_ + 1) % buf_.size();
+  --size_;
+}
+
+// -- ewma_rate_meter ----------------------------------------------------------
+
+ewma_rate_meter::ewma_rate_meter(tick_duration tau)
+    : tau_(tau > 0 ? tau : 1),
+      last_(0),
+      rate_(0) {
+  // nop
+}
+
+void ewma_rate_meter::add(tick_time tstamp, size_t num_elements) {
+  rate_ = rate(tstamp) + num_elements / to_seconds(tau_);
+  last_ = tstamp;
+}
+
+double ewma_rate_meter::rate(tick_time tstamp) const {
+  if (tstamp <= last_)
+    return rate_;
+  return rate_ * std::exp(-static_cast<double>(tstamp - last_) / tau_);
+}
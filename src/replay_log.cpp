@@ -0,0 +1,322 @@
+#include "replay_log.hpp"
+
+#include <cstring>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "varint.hpp"
+
+namespace {
+
+constexpr uint32_t format_version = 1;
+
+constexpr size_t magic_size = sizeof(replay_log_magic) - 1;
+
+constexpr size_t trailer_size = sizeof(uint64_t) + magic_size;
+
+/// Distance between indexed frames in ticks.
+constexpr tick_time index_interval = 1024;
+
+} // namespace <anonymous>
+
+// -- replay_log_writer --------------------------------------------------------
+
+replay_log_writer::replay_log_writer()
+    : file_(nullptr),
+      offset_(0),
+      last_tick_(0),
+      frame_tick_(0) {
+  // nop
+}
+
+replay_log_writer::~replay_log_writer() {
+  close();
+}
+
+bool replay_log_writer::open(const std::string& path, uint32_t seed,
+                             const std::string& layout) {
+  close();
+  file_ = fopen(path.c_str(), "wb");
+  if (file_ == nullptr)
+    return false;
+  buf_.assign(replay_log_magic, replay_log_magic + magic_size);
+  put_varint(buf_, format_version);
+  put_varint(buf_, seed);
+  put_varint(buf_, layout.size());
+  buf_.insert(buf_.end(), layout.begin(), layout.end());
+  write(buf_);
+  last_tick_ = 0;
+  frame_tick_ = 0;
+  frame_.clear();
+  index_.clear();
+  return true;
+}
+
+void replay_log_writer::close() {
+  if (file_ == nullptr)
+    return;
+  flush_frame();
+  auto index_offset = offset_;
+  buf_.clear();
+  put_varint(buf_, index_.size());
+  std::pair<tick_time, uint64_t> prev{0, 0};
+  for (auto& x : index_) {
+    put_varint(buf_, static_cast<uint64_t>(x.first - prev.first));
+    put_varint(buf_, x.second - prev.second);
+    prev = x;
+  }
+  for (size_t i = 0; i < sizeof(uint64_t); ++i)
+    buf_.emplace_back(static_cast<uint8_t>(index_offset >> (i * 8)));
+  buf_.insert(buf_.end(), replay_log_index_magic,
+              replay_log_index_magic + magic_size);
+  write(buf_);
+  fclose(file_);
+  file_ = nullptr;
+}
+
+void replay_log_writer::delivery(tick_time t, int32_t receiver,
+                                 tick_duration delay) {
+  add(t, replay_entry::delivery, receiver, delay);
+}
+
+void replay_log_writer::tick_event(tick_time t, tick_duration delay) {
+  add(t, replay_entry::tick_event, delay, 0);
+}
+
+void replay_log_writer::add(tick_time t, replay_entry kind, int32_t x,
+                            int32_t y) {
+  if (file_ == nullptr)
+    return;
+  if (t != frame_tick_) {
+    flush_frame();
+    frame_tick_ = t;
+  }
+  // Most entries fit into two or three bytes: the first varint combines the
+  // kind with the first argument.
+  put_varint(frame_, (zigzag(x) << 1) | static_cast<uint64_t>(kind));
+  if (kind == replay_entry::delivery)
+    put_varint(frame_, zigzag(y));
+}
+
+void replay_log_writer::flush_frame() {
+  if (frame_.empty())
+    return;
+  if (index_.empty()
+      || frame_tick_ / index_interval != index_.back().first / index_interval)
+    index_.emplace_back(frame_tick_, offset_);
+  buf_.clear();
+  put_varint(buf_, static_cast<uint64_t>(frame_tick_ - last_tick_));
+  put_varint(buf_, frame_.size());
+  write(buf_);
+  write(frame_);
+  last_tick_ = frame_tick_;
+  frame_.clear();
+}
+
+void replay_log_writer::write(const std::vector<uint8_t>& buf) {
+  fwrite(buf.data(), 1, buf.size(), file_);
+  offset_ += buf.size();
+}
+
+// -- replay_log_reader --------------------------------------------------------
+
+replay_log_reader::replay_log_reader()
+    : data_(nullptr),
+      size_(0),
+      first_frame_(0),
+      frames_end_(0),
+      pos_(0),
+      entry_pos_(0),
+      frame_end_(0),
+      frame_tick_(0),
+      last_tick_(0),
+      seed_(0) {
+  // nop
+}
+
+replay_log_reader::~replay_log_reader() {
+  unmap();
+}
+
+bool replay_log_reader::open(const std::string& path) {
+  unmap();
+  auto fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(magic_size)) {
+    ::close(fd);
+    return false;
+  }
+  auto ptr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+                  MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (ptr == MAP_FAILED)
+    return false;
+  data_ = static_cast<const uint8_t*>(ptr);
+  size_ = static_cast<size_t>(st.st_size);
+  // Read the header.
+  size_t pos = magic_size;
+  uint64_t version = 0;
+  uint64_t seed = 0;
+  uint64_t layout_size = 0;
+  if (memcmp(data_, replay_log_magic, magic_size) != 0
+      || !get_varint(data_, size_, pos, version) || version != format_version
+      || !get_varint(data_, size_, pos, seed)
+      || !get_varint(data_, size_, pos, layout_size)
+      || layout_size > size_ - pos) {
+    unmap();
+    return false;
+  }
+  seed_ = static_cast<uint32_t>(seed);
+  layout_.assign(reinterpret_cast<const char*>(data_ + pos), layout_size);
+  first_frame_ = pos + layout_size;
+  // Read the index from the trailer if possible.
+  index_.clear();
+  frames_end_ = size_;
+  if (size_ - first_frame_ >= trailer_size
+      && memcmp(data_ + size_ - magic_size, replay_log_index_magic,
+                magic_size) == 0) {
+    uint64_t index_offset = 0;
+    for (size_t i = 0; i < sizeof(uint64_t); ++i)
+      index_offset |= static_cast<uint64_t>(data_[size_ - trailer_size + i])
+                      << (i * 8);
+    size_t pos = index_offset;
+    uint64_t n = 0;
+    if (index_offset >= first_frame_ && index_offset <= size_ - trailer_size
+        && get_varint(data_, size_, pos, n)) {
+      std::pair<tick_time, uint64_t> x{0, 0};
+      uint64_t dt = 0;
+      uint64_t doffset = 0;
+      for (uint64_t i = 0; i < n; ++i) {
+        if (!get_varint(data_, size_, pos, dt)
+            || !get_varint(data_, size_, pos, doffset))
+          break;
+        x.first += static_cast<tick_time>(dt);
+        x.second += doffset;
+        index_.emplace_back(x);
+      }
+      if (index_.size() == n)
+        frames_end_ = index_offset;
+      else
+        index_.clear();
+    }
+  }
+  if (index_.empty())
+    scan_frames(first_frame_, 0, false);
+  else
+    scan_frames(index_.back().second, index_.back().first, true);
+  seek(0);
+  return true;
+}
+
+void replay_log_reader::seek(tick_time t) {
+  // Find the last indexed frame with a tick not greater than `t`.
+  auto i = std::upper_bound(index_.begin(), index_.end(), t,
+                            [](tick_time x,
+                               const std::pair<tick_time, uint64_t>& y) {
+                              return x < y.first;
+                            });
+  entry_pos_ = frame_end_ = 0;
+  if (i == index_.begin()) {
+    pos_ = first_frame_;
+    if (!read_frame(0))
+      return;
+  } else {
+    --i;
+    pos_ = i->second;
+    if (!read_frame(0))
+      return;
+    frame_tick_ = i->first;
+  }
+  while (frame_tick_ < t)
+    if (!read_frame(frame_tick_))
+      return;
+}
+
+bool replay_log_reader::delivery(tick_time t, int32_t receiver,
+                                 tick_duration& delay) {
+  replay_entry kind;
+  int32_t x;
+  if (!next(t, kind, x, delay))
+    return false;
+  return kind == replay_entry::delivery && x == receiver;
+}
+
+bool replay_log_reader::tick_event(tick_time t, tick_duration& delay) {
+  replay_entry kind;
+  int32_t y;
+  if (!next(t, kind, delay, y))
+    return false;
+  return kind == replay_entry::tick_event;
+}
+
+bool replay_log_reader::next(tick_time t, replay_entry& kind, int32_t& x,
+                             int32_t& y) {
+  // Frames are never empty, i.e., reaching the end of a frame means all of
+  // its entries were consumed.
+  if (entry_pos_ == frame_end_ && !read_frame(frame_tick_))
+    return false;
+  if (frame_tick_ != t)
+    return false;
+  uint64_t tmp;
+  if (!get_varint(data_, frame_end_, entry_pos_, tmp))
+    return false;
+  kind = static_cast<replay_entry>(tmp & 1);
+  x = static_cast<int32_t>(unzigzag(tmp >> 1));
+  y = 0;
+  if (kind == replay_entry::delivery) {
+    if (!get_varint(data_, frame_end_, entry_pos_, tmp))
+      return false;
+    y = static_cast<int32_t>(unzigzag(tmp));
+  }
+  return true;
+}
+
+bool replay_log_reader::read_frame(tick_time base) {
+  uint64_t dt;
+  uint64_t n;
+  auto pos = pos_;
+  if (pos >= frames_end_ || !get_varint(data_, frames_end_, pos, dt)
+      || !get_varint(data_, frames_end_, pos, n) || n > frames_end_ - pos) {
+    entry_pos_ = frame_end_ = pos_ = frames_end_;
+    return false;
+  }
+  frame_tick_ = base + static_cast<tick_time>(dt);
+  entry_pos_ = pos;
+  frame_end_ = pos + n;
+  pos_ = frame_end_;
+  return true;
+}
+
+void replay_log_reader::scan_frames(size_t offset, tick_time t,
+                                    bool known_tick) {
+  pos_ = offset;
+  frame_tick_ = 0;
+  last_tick_ = t;
+  while (pos_ < frames_end_) {
+    auto frame_offset = pos_;
+    if (!read_frame(frame_tick_))
+      break;
+    if (known_tick) {
+      frame_tick_ = t;
+      known_tick = false;
+    }
+    if (index_.empty()
+        || frame_tick_ / index_interval != index_.back().first / index_interval)
+      index_.emplace_back(frame_tick_, frame_offset);
+    last_tick_ = frame_tick_;
+  }
+}
+
+void replay_log_reader::unmap() {
+  if (data_ != nullptr) {
+    munmap(const_cast<uint8_t*>(data_), size_);
+    data_ = nullptr;
+    size_ = 0;
+  }
+}
@@ -1,7 +1,9 @@
 #include "simulant.hpp"
 
+#include <tuple>
 #include <string>
 #include <iostream>
+#include <algorithm>
 
 #include "caf/stream.hpp"
 #include "caf/stream_manager.hpp"
@@ -11,6 +13,8 @@
 
 #include "qstr.hpp"
 #include "entity.hpp"
+#include "checkpoint.hpp"
+#include "gatherer.hpp"
 #include "environment.hpp"
 #include "term_gatherer.hpp"
 
@@ -28,7 +32,10 @@ simulant::simulant(caf::actor_config& cfg, entity* parent)
     env_(parent->env()),
     parent_(parent),
     model_(this, parent->id()),
-    msg_ids_(0) {
+    msg_ids_(0),
+    version_(1),
+    received_at_(0),
+    state_tree_built_(false) {
   set_exception_handler(silent_exception_handler);
 }
 
@@ -43,10 +50,7 @@ void simulant::enqueue(caf::mailbox_element_ptr ptr, caf::execution_unit*) {
   auto local_mid = peek_pending_message(ptr.get());
   if (local_mid == 0) {
     local_mid = push_pending_message(ptr.get());
-    auto self = caf::strong_actor_ptr{ctrl()};
-    env_->post_f(-1, [=, me = std::move(ptr)](tick_time) mutable {
-      self->enqueue(std::move(me), nullptr);
-    });
+    env_->transmit(caf::strong_actor_ptr{ctrl()}, std::move(ptr));
     return;
   }
   auto msg = ptr->copy_content_to_message();
@@ -54,13 +58,19 @@ void simulant::enqueue(caf::mailbox_element_ptr ptr, caf::execution_unit*) {
   super::enqueue(std::move(ptr), nullptr);
   critical_section(parent_mtx_, [&] {
     auto pptr = parent_.load();
-    if (pptr)
+    if (pptr) {
+      env_->activate(pptr);
+      pptr->refresh_mailbox();
       emit pptr->message_received(local_mid, sender, msg);
+    }
   });
 }
 
 caf::invoke_message_result simulant::consume(caf::mailbox_element& x) {
   auto local_mid = pop_pending_message(&x);
+  auto pptr = parent_.load();
+  if (pptr == nullptr || !env_->receive_time(pptr, local_mid, received_at_))
+    received_at_ = env_->timestamp();
   env_->post_f([=](tick_time) {
     critical_section(parent_mtx_, [&] {
       auto pptr = parent_.load();
@@ -104,13 +114,17 @@ T qt_fwd(environment*, T x) {
 } // namespace <anonymous>
 
 // Put a field with a member function getter.
-#define PUT_MF(var, field) pt.put(qstr(#field), qt_fwd(env_, var.field()))
+#define PUT_MF(var, field) pt.put(#field, qt_fwd(env_, var.field()))
 
 // Put a field with a member variable.
-#define PUT_MV(var, field) pt.put(qstr(#field), qt_fwd(env_, (var).field))
+#define PUT_MV(var, field) pt.put(#field, qt_fwd(env_, (var).field))
 
 class scoped_path_entry {
 public:
+  scoped_path_entry() : path_(nullptr) {
+    // nop
+  }
+
   scoped_path_entry(simulant_tree_item& root, std::vector<QString>& path,
                     QString id, QVariant val)
       : path_(&path) {
@@ -131,77 +145,137 @@ private:
   std::vector<QString>* path_;
 };
 
+/// Writes fields into the tree. When rebuilding, inserts all items by path
+/// and records the leaves in order. Otherwise, skips all inner items and
+/// visits the recorded leaves in the same order.
 class path_traverser {
 public:
-  path_traverser(simulant_tree_item& root) : root_(root) {
+  path_traverser(simulant_tree_item& root,
+                 std::vector<simulant_tree_item*>& leaves, bool rebuild)
+      : root_(root),
+        leaves_(leaves),
+        rebuild_(rebuild),
+        pos_(0) {
     // nop
   }
 
-  scoped_path_entry enter(QString id, QVariant val) {
-    return {root_, path_, std::move(id), std::move(val)};
+  template <class T>
+  scoped_path_entry enter(const T& id, const char* type) {
+    if (!rebuild_)
+      return {};
+    return {root_, path_, qstr(id), qstr(type)};
   }
 
-  void put(QString id, QVariant val) {
-    enter(id, val);
+  void put(const char* id, QVariant val) {
+    if (!rebuild_) {
+      leaves_[pos_++]->update_value(std::move(val));
+      return;
+    }
+    path_.emplace_back(qstr(id));
+    leaves_.emplace_back(root_.insert_or_update(path_, std::move(val)));
+    path_.pop_back();
   }
 
 private:
   simulant_tree_item& root_;
+  std::vector<simulant_tree_item*>& leaves_;
+  bool rebuild_;
+  size_t pos_;
   std::vector<QString> path_;
 };
 
 void simulant::serialize_state(simulant_tree_item& root) {
-  path_traverser pt{root};
-  // Mark tree as stale.
-  root.mark_as_stale();
+  // Compare the current streams and paths with the last rebuild.
+  std::vector<const void*> layout;
+  for (auto& x : streams()) {
+    auto mgr = x.second.get();
+    layout.emplace_back(mgr);
+    auto& in = mgr->in();
+    for (long path_id = 0; path_id < in.num_paths(); ++path_id)
+      layout.emplace_back(in.path_at(path_id));
+    layout.emplace_back(nullptr);
+    auto& out = mgr->out();
+    for (long path_id = 0; path_id < out.num_paths(); ++path_id)
+      layout.emplace_back(out.path_at(path_id));
+    layout.emplace_back(nullptr);
+  }
+  auto rebuild = !state_tree_built_ || layout != state_layout_;
+  if (rebuild) {
+    state_tree_built_ = true;
+    state_layout_.swap(layout);
+    state_leaves_.clear();
+    // Mark tree as stale.
+    root.mark_as_stale();
+  }
+  path_traverser pt{root, state_leaves_, rebuild};
   // Update the tree.
   { // lifetime scope of streams entry
-    auto streams_entry = pt.enter(qstr("streams"), qstr("<list:stream>"));
+    auto streams_entry = pt.enter("streams", "<list:stream>");
     for (auto& x : streams()) {
       auto mgr = x.second;
-      auto stream_entry = pt.enter(qstr(mgr.get()), qstr("<stream>"));
+      auto stream_entry = pt.enter(mgr.get(), "<stream>");
       { // lifetime scope of in
         auto& in = mgr->in();
-        auto in_entry = pt.enter(qstr("in"), qstr("<stream_gatherer>"));
+        auto in_entry = pt.enter("in", "<stream_gatherer>");
         PUT_MF(in, continuous);
         PUT_MF(in, high_watermark);
         PUT_MF(in, min_credit_assignment);
         PUT_MF(in, max_credit);
         auto tg = dynamic_cast<term_gatherer*>(&in);
         if (tg != nullptr) {
+          PUT_MV(*tg, cycle_duration);
           PUT_MV(*tg, min_tokens_);
           PUT_MV(*tg, desired_batch_complexity_);
+          PUT_MV(*tg, target_queueing_delay_);
+          PUT_MV(*tg, max_min_fairness_);
           PUT_MV(*tg, last_cycle_);
           PUT_MV(*tg, last_token_count_);
           PUT_MV(*tg, historic_time_per_item_);
           PUT_MV(*tg, processing_time_);
           PUT_MV(*tg, processed_items_);
+          if (tg->tuner_ != nullptr) {
+            // Fixed number of leaves to keep the tree layout stable.
+            static constexpr const char* ids[] = {"0", "1", "2", "3",
+                                                  "4", "5", "6", "7"};
+            static_assert(sizeof(ids) / sizeof(ids[0])
+                            == batch_tuner::max_decisions,
+                          "one id per decision required");
+            auto tuner_entry = pt.enter("tuner", "<batch_tuner>");
+            pt.put("latency_target", qt_fwd(env_, tg->tuner_->target()));
+            auto& xs = tg->tuner_->decisions();
+            for (size_t i = 0; i < batch_tuner::max_decisions; ++i)
+              pt.put(ids[i], i < xs.size() ? qstr(xs[i]) : QString{});
+          }
         }
-        auto paths_entry = pt.enter(qstr("paths"), qstr("<list:inbound_path>"));
+        auto g = dynamic_cast<gatherer*>(&in);
+        auto paths_entry = pt.enter("paths", "<list:inbound_path>");
         for (long path_id = 0; path_id < in.num_paths(); ++path_id) {
           auto path = in.path_at(path_id);
-          auto path_entry = pt.enter(qstr(path), qstr("<inbound_path>"));
+          auto path_entry = pt.enter(path, "<inbound_path>");
           PUT_MV(*path, sid);
           PUT_MV(*path, hdl);
           PUT_MV(*path, prio);
           PUT_MV(*path, last_acked_batch_id);
           PUT_MV(*path, last_batch_id);
           PUT_MV(*path, assigned_credit);
+          PUT_MV(*path, desired_batch_size);
           PUT_MV(*path, redeployable);
+          if (g != nullptr)
+            pt.put("rate", g->rate(path));
         }
       }
       { // lifetime scope of out
         auto& out = mgr->out();
-        auto out_entry = pt.enter(qstr("out"), qstr("<stream_scatterer>"));
+        auto out_entry = pt.enter("out", "<stream_scatterer>");
         PUT_MF(out, continuous);
         PUT_MF(out, credit);
         PUT_MF(out, buffered);
         PUT_MF(out, min_batch_size);
         PUT_MF(out, min_buffer_size);
-        auto paths_entry = pt.enter(qstr("paths"), qstr("<list:outbound_path>"));
+        auto paths_entry = pt.enter("paths", "<list:outbound_path>");
         for (long path_id = 0; path_id < out.num_paths(); ++path_id) {
           auto path = out.path_at(path_id);
-          auto path_entry = pt.enter(qstr(path), qstr("<outbound_path>"));
+          auto path_entry = pt.enter(path, "<outbound_path>");
           PUT_MV(*path, sid);
           PUT_MV(*path, hdl);
           PUT_MV(*path, next_batch_id);
@@ -213,7 +287,76 @@ void simulant::serialize_state(simulant_tree_item& root) {
     }
   } // leave streams entry
   // Remove any leaf that hasen't been updated.
-  root.purge();
+  if (rebuild)
+    root.purge();
+}
+
+void simulant::save_state(state_writer& out) {
+  auto put_sid = [&](const caf::stream_id& x) {
+    out.put(env_->rank_of(x.origin));
+    out.put(x.nr);
+  };
+  std::vector<uint32_t> mailbox_content;
+  iterate_mailbox([&](auto& x) {
+    mailbox_content.emplace_back(x.content().type_token());
+  });
+  out.put(mailbox_content.size());
+  for (auto x : mailbox_content)
+    out.put(x);
+  out.put(msg_ids_.load());
+  // The streams map has no canonical order.
+  using stream_entry = std::tuple<int32_t, uint64_t, caf::stream_manager*>;
+  std::vector<stream_entry> xs;
+  for (auto& x : streams())
+    xs.emplace_back(env_->rank_of(x.first.origin), x.first.nr,
+                    x.second.get());
+  std::sort(xs.begin(), xs.end());
+  out.put(xs.size());
+  for (auto& x : xs) {
+    auto mgr = std::get<2>(x);
+    out.put(std::get<0>(x));
+    out.put(std::get<1>(x));
+    auto& in = mgr->in();
+    out.put(in.continuous());
+    out.put(in.high_watermark());
+    out.put(in.min_credit_assignment());
+    out.put(in.max_credit());
+    auto tg = dynamic_cast<term_gatherer*>(&in);
+    out.put(tg != nullptr);
+    if (tg != nullptr)
+      tg->save_state(out);
+    auto g = dynamic_cast<gatherer*>(&in);
+    out.put(g != nullptr);
+    if (g != nullptr)
+      g->save_state(out);
+    out.put(in.num_paths());
+    for (long path_id = 0; path_id < in.num_paths(); ++path_id) {
+      auto path = in.path_at(path_id);
+      put_sid(path->sid);
+      out.put(env_->rank_of(path->hdl));
+      out.put(static_cast<int>(path->prio));
+      out.put(path->last_acked_batch_id);
+      out.put(path->last_batch_id);
+      out.put(path->assigned_credit);
+      out.put(path->redeployable);
+    }
+    auto& out_mgr = mgr->out();
+    out.put(out_mgr.continuous());
+    out.put(out_mgr.credit());
+    out.put(out_mgr.buffered());
+    out.put(out_mgr.min_batch_size());
+    out.put(out_mgr.min_buffer_size());
+    out.put(out_mgr.num_paths());
+    for (long path_id = 0; path_id < out_mgr.num_paths(); ++path_id) {
+      auto path = out_mgr.path_at(path_id);
+      put_sid(path->sid);
+      out.put(env_->rank_of(path->hdl));
+      out.put(path->next_batch_id);
+      out.put(path->open_credit);
+      out.put(path->redeployable);
+      out.put(path->next_ack_id);
+    }
+  }
 }
 
 void simulant::detach_from_parent() {
@@ -1,6 +1,6 @@
 #include "include/simulant_tree_item.hpp"
 
-#include <iostream>
+#include <utility>
 
 #include "include/simulant_tree_model.hpp"
 
@@ -11,46 +11,38 @@ simulant_tree_item::simulant_tree_item(simulant_tree_model* model,
     parent_(parent),
     id_(std::move(id)),
     value_(std::move(value)),
+    row_(0),
+    gap_pos_(0),
+    gap_size_(0),
     stale_(false) {
   // nop
 }
 
 simulant_tree_item* simulant_tree_item::child(int x) {
-  return children_[static_cast<size_t>(x)].get();
+  return children_[pos_of(x)].get();
 }
 
 void simulant_tree_item::remove_child(int x) {
   auto i = children_.begin() + x;
-  model_->beginRemoveColumns(index(), x, x);
-  children_.erase(i);
-  model_->endRemoveColumns();
+  model_->beginRemoveRows(index(), x, x);
+  children_index_.remove((*i)->id());
+  i = children_.erase(i);
+  for (auto e = children_.end(); i != e; ++i)
+    --(*i)->row_;
+  model_->endRemoveRows();
 }
 
 int simulant_tree_item::child_count() const {
-  return static_cast<int>(children_.size());
+  return static_cast<int>(children_.size() - gap_size_);
 }
 
 int simulant_tree_item::index_of(const QString& x) const {
-  auto pred = [=](const owning_pointer& y) {
-    return x == y->id();
-  };
-  auto e = children_.end();
-  auto b = children_.begin();
-  auto i = std::find_if(b, e, pred);
-  if (i != e)
-    return std::distance(b, i);
+  auto i = children_index_.find(x);
+  if (i != children_index_.end())
+    return row_of((*i)->row_);
   return -1;
 }
 
-int simulant_tree_item::index_at_parent() const {
-  if (!parent_)
-    return 0;
-  for (auto i = 0; i < parent_->child_count(); ++i)
-    if (parent_->child(i) == this)
-      return i;
-  throw std::logic_error("unable to compute index_at_parent");
-}
-
 QVariant simulant_tree_item::data(int x) const {
   return x == 0 ? id_ : value_;
 }
@@ -63,12 +55,8 @@ simulant_tree_item* simulant_tree_item::lookup(path::const_iterator child_id,
                                                path::const_iterator end) {
   if (child_id == end)
     return this;
-  auto pred = [=](owning_pointer& x) {
-    return x->id() == *child_id;
-  };
-  auto e = children_.end();
-  auto i = std::find_if(children_.begin(), e, pred);
-  return i != e ? (*i)->lookup(++child_id, end) : nullptr;
+  auto i = children_index_.find(*child_id);
+  return i != children_index_.end() ? (*i)->lookup(++child_id, end) : nullptr;
 }
 
 simulant_tree_item*
@@ -78,29 +66,31 @@ simulant_tree_item::insert_or_update(path::const_iterator child_id,
   if (child_id == end) {
     if (stale_)
       stale_ = false;
-    if (value_ != value) {
-      value_.swap(value);
-      auto ix = index(1);
-      model_->dataChanged(ix, ix);
-    }
+    update_value(std::move(value));
     return this;
   }
-  auto pred = [=](owning_pointer& x) {
-    return x->id() == *child_id;
-  };
-  auto e = children_.end();
-  auto i = std::find_if(children_.begin(), e, pred);
-  if (i != e)
+  auto i = children_index_.find(*child_id);
+  if (i != children_index_.end())
     return (*i)->insert_or_update(++child_id, end, std::move(value));
   if (child_id + 1 != end)
     return nullptr;
   auto ix = index();
   auto row = static_cast<int>(children_.size());
   model_->beginInsertRows(ix, row, row);
-  children_.emplace_back(new simulant_tree_item(model_, this, *child_id,
-                                                std::move(value)));
+  auto ptr = new simulant_tree_item(model_, this, *child_id, std::move(value));
+  ptr->row_ = children_.size();
+  children_.emplace_back(ptr);
+  children_index_.insert(ptr->id(), ptr);
   model_->endInsertRows();
-  return children_.back().get();
+  return ptr;
+}
+
+void simulant_tree_item::update_value(QVariant x) {
+  if (value_ != x) {
+    value_.swap(x);
+    auto ix = index(1);
+    model_->dataChanged(ix, ix);
+  }
 }
 
 QModelIndex simulant_tree_item::index(int column) {
@@ -117,27 +107,37 @@ void simulant_tree_item::mark_as_stale() {
 }
 
 void simulant_tree_item::purge() {
-  auto is_stale = [](const owning_pointer& x) {
-    return x->stale();
-  };
-  auto is_not_stale = [](const owning_pointer& x) {
-    return !x->stale();
-  };
-  auto e = children_.end();
-  auto b = children_.begin();
-  auto i = std::find_if(b, e, is_stale);
-  if (i != e) {
-    // Take out consecutive stale children at once by computing iterator
-    // to the first *not* deleted child.
-    auto j = std::find_if(i + 1, e, is_not_stale);
-    // Compute IDs of first and last (inclusive) deleted rows.
-    auto row_first = std::distance(b, i);
-    auto row_last = std::distance(b, j) - 1;
-    // Remove from model and vector.
+  // Compact `children_` in place. Everything before `gap_pos_` has been
+  // visited and everything after the gap is untouched. Hence, `row_of` and
+  // `pos_of` remain valid for the model whenever a view inspects this item
+  // after `endRemoveRows`.
+  auto n = children_.size();
+  size_t pos = 0;
+  while (pos < n) {
+    if (!children_[pos]->stale()) {
+      if (gap_size_ > 0) {
+        children_[gap_pos_] = std::move(children_[pos]);
+        children_[gap_pos_]->row_ = gap_pos_;
+      }
+      children_[gap_pos_++]->purge();
+      ++pos;
+      continue;
+    }
+    // Take out consecutive stale children at once.
+    auto last = pos + 1;
+    while (last < n && children_[last]->stale())
+      ++last;
+    auto row_first = static_cast<int>(gap_pos_);
+    auto row_last = row_first + static_cast<int>(last - pos) - 1;
     model_->beginRemoveRows(index(), row_first, row_last);
-    children_.erase(i, j);
+    for (; pos < last; ++pos) {
+      children_index_.remove(children_[pos]->id());
+      children_[pos].reset();
+      ++gap_size_;
+    }
     model_->endRemoveRows();
-    // Recurse until all stale children have been removed.
-    purge();
   }
+  children_.resize(gap_pos_);
+  gap_pos_ = 0;
+  gap_size_ = 0;
 }
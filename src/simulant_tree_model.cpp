@@ -6,7 +6,9 @@
 
 simulant_tree_model::simulant_tree_model(simulant* parent, QString root_id)
   : parent_(parent),
-    root_(this, nullptr, std::move(root_id), QString::fromUtf8("<actor>")) {
+    root_(this, nullptr, std::move(root_id), QString::fromUtf8("<actor>")),
+    observers_(0),
+    version_(0) {
   // nop
 }
 
@@ -58,5 +60,18 @@ simulant_tree_item* simulant_tree_model::ptr(const QModelIndex& x) const {
 }
 
 void simulant_tree_model::update() {
+  if (observers_ == 0 || version_ == parent_->version())
+    return;
+  version_ = parent_->version();
   parent_->serialize_state(root_);
 }
+
+void simulant_tree_model::add_observer() {
+  ++observers_;
+  update();
+}
+
+void simulant_tree_model::remove_observer() {
+  if (observers_ > 0)
+    --observers_;
+}
@@ -19,14 +19,11 @@
 
 #include "sink.hpp"
 
-#include <QWidget>
-
 #include "caf/stream.hpp"
 #include "caf/terminal_stream_scatterer.hpp"
 
 #include "caf/policy/arg.hpp"
 
-#include "entity_details.hpp"
 #include "environment.hpp"
 #include "gatherer.hpp"
 #include "qstr.hpp"
@@ -37,7 +34,10 @@
 using namespace caf;
 
 sink::sink(environment* env, QWidget* parent, QString name)
-    : entity(env, parent, name) {
+    : entity(env, parent, name),
+      last_batch_path_(nullptr),
+      last_batch_received_(0),
+      last_batch_start_(0) {
   // nop
 }
 
@@ -47,8 +47,6 @@ sink::~sink() {
 
 void sink::start() {
   CAF_LOG_TRACE("");
-  dialog_->drop_stage_widgets();
-  dialog_->drop_source_widgets();
   simulant_->become(
     [=](const stream<int>& in) {
       CAF_LOG_TRACE(CAF_ARG(in));
@@ -75,28 +73,33 @@ void sink::start() {
             CAF_LOG_DEBUG("first-time run, set started_ = true");
             started_ = true;
           }
-          if (text(dialog_->sink_current_sender).isEmpty()) {
+          if (current_sender_.isEmpty()) {
             auto me = simulant_->current_mailbox_element();
-            text(dialog_->sink_current_sender, env_->id_by_handle(me->sender));
+            current_sender_ = env_->id_by_handle(me->sender);
             auto& sm = me->content().get_as<stream_msg>(0);
             auto& op = get<stream_msg::batch>(sm.content);
-            max(dialog_->sink_batch_progress, static_cast<int>(op.xs_size));
+            batch_progress_.maximum = static_cast<int>(op.xs_size);
+            last_batch_path_ = smp->in().find(
+              sm.sid, caf::actor_cast<caf::actor_addr>(me->sender));
+            last_batch_received_ = simulant_->received_at();
             last_batch_start_ = env_->timestamp();
             CAF_LOG_DEBUG("initialized batch processing, yield");
             yield();
           }
           CAF_LOG_DEBUG("enter progress loop, yield ticks_per_item times");
-          progress(dialog_->sink_item_progress, 0,
-                   val(dialog_->sink_ticks_per_item));
-          inc(dialog_->sink_batch_progress);
-          if (at_max(dialog_->sink_batch_progress)) {
+          progress(item_progress_, 0, params_.ticks_per_item);
+          ++batch_progress_.value;
+          if (batch_progress_.at_max()) {
             CAF_LOG_DEBUG("got last item in batch, record at gatherer");
+            // The path may have closed while we processed its batch.
             auto& sg = static_cast<term_gatherer&>(smp->in());
-            sg.batch_completed(val(dialog_->sink_batch_progress), 0,
-                               last_batch_start_, env_->timestamp());
+            if (sg.contains(last_batch_path_))
+              sg.batch_completed(last_batch_path_, batch_progress_.value,
+                                 last_batch_received_, last_batch_start_,
+                                 env_->timestamp());
             yield();
-            text(dialog_->sink_current_sender, qstr(""));
-            reset(dialog_->sink_batch_progress, 0, 1);
+            current_sender_.clear();
+            batch_progress_ = progress_state{0, 1};
           }
         },
         [](unit_t&) {
@@ -118,5 +121,6 @@ void sink::start() {
   );
   // Run initialization code of the simulant and update state model.
   simulant_->activate(env_->sys().dummy_execution_unit());
+  simulant_->touch();
   simulant_->model()->update();
 }
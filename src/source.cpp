@@ -22,7 +22,6 @@
 #include "caf/stream.hpp"
 
 #include "environment.hpp"
-#include "entity_details.hpp"
 
 source::source(environment* env, QWidget* parent, QString name)
     : entity(env, parent, name) {
@@ -34,8 +33,6 @@ source::~source() {
 }
 
 void source::start() {
-  dialog_->drop_sink_widgets();
-  dialog_->drop_stage_widgets();
   stream_manager_ = simulant_->make_source(
     consumers_.front(),
     [](caf::unit_t&) {
@@ -44,8 +41,8 @@ void source::start() {
     [=](caf::unit_t&, caf::downstream<int>& out, size_t n) {
       if (!started_)
         started_ = true;
-      progress(dialog_->source_batch_generation, 0, static_cast<int>(n), [&](int i) {
-        progress(dialog_->source_item_generation, 1, val(dialog_->source_rate));
+      progress(batch_progress_, 0, static_cast<int>(n), [&](int i) {
+        progress(item_progress_, 1, params_.source_rate);
         out.push(i);
       });
     },
@@ -59,6 +56,7 @@ void source::start() {
   // TODO: add remaining consumers to the stream.
   // Run initialization code of the simulant and update state model.
   simulant_->activate(env_->sys().dummy_execution_unit());
+  simulant_->touch();
   simulant_->model()->update();
 }
 
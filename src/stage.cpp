@@ -19,20 +19,22 @@
 
 #include "stage.hpp"
 
-#include <QLabel>
-#include <QTreeView>
-
 #include "caf/stream.hpp"
+#include "caf/inbound_path.hpp"
 
+#include "gatherer.hpp"
+#include "scatterer.hpp"
 #include "environment.hpp"
-#include "entity_details.hpp"
 #include "qstr.hpp"
 
 stage::stage(environment* env, QWidget* parent, QString name)
     : entity(env, parent, name),
       source(env, parent, name),
       sink(env, parent, name),
-      completed_items_(0) {
+      completed_items_(0),
+      batch_path_(nullptr),
+      batch_received_(0),
+      batch_start_(0) {
   // nop
 }
 
@@ -41,7 +43,6 @@ stage::~stage() {
 }
 
 void stage::start() {
-  dialog_->drop_source_only_widgets();
   simulant_->become(
     [=](const caf::stream<int>& in) {
       auto& stages = simulant_->current_mailbox_element()->stages;
@@ -64,33 +65,45 @@ void stage::start() {
         [=](caf::unit_t&, caf::downstream<int>& out, int) {
           if (!started_)
             started_ = true;
-          if (text(dialog_->sink_current_sender).isEmpty()) {
+          if (current_sender_.isEmpty()) {
             auto me = simulant_->current_mailbox_element();
-            text(dialog_->sink_current_sender, env_->id_by_handle(me->sender));
+            current_sender_ = env_->id_by_handle(me->sender);
             auto& sm = me->content().get_as<caf::stream_msg>(0);
             auto& op = caf::get<caf::stream_msg::batch>(sm.content);
-            max(dialog_->sink_batch_progress, static_cast<int>(op.xs_size));
+            batch_progress_.maximum = static_cast<int>(op.xs_size);
+            batch_path_ = stream_manager_->in().find(
+              sm.sid, caf::actor_cast<caf::actor_addr>(me->sender));
+            batch_received_ = simulant_->received_at();
+            batch_start_ = env_->timestamp();
             yield();
           }
-          progress(dialog_->sink_item_progress, 0, val(dialog_->sink_ticks_per_item));
-          inc(dialog_->sink_batch_progress);
-          if (++completed_items_ >= val(dialog_->ratio_in)) {
+          progress(item_progress_, 0, params_.ticks_per_item);
+          ++batch_progress_.value;
+          if (++completed_items_ >= params_.ratio_in) {
             completed_items_ = 0;
-            for (int i = 0; i < val(dialog_->ratio_out); ++i)
+            for (int i = 0; i < params_.ratio_out; ++i)
               out.push(i);
           }
-          if (at_max(dialog_->sink_batch_progress)) {
-            text(dialog_->sink_current_sender, qstr(""));
-            reset(dialog_->sink_batch_progress, 0, 1);
+          if (batch_progress_.at_max()) {
+            // The path may have closed while we processed its batch.
+            auto& g = static_cast<gatherer&>(stream_manager_->in());
+            if (g.contains(batch_path_))
+              g.batch_completed(batch_path_, batch_progress_.value,
+                                batch_received_, batch_start_,
+                                env_->timestamp());
+            current_sender_.clear();
+            batch_progress_ = progress_state{0, 1};
           }
         },
         [](caf::unit_t&) {
           // nop
-        }
+        },
+        caf::policy::arg<gatherer, scatterer<int>>::value
       ).ptr();
     }
   );
   // Run initialization code of the simulant and update state model.
   simulant_->activate(env_->sys().dummy_execution_unit());
+  simulant_->touch();
   simulant_->model()->update();
 }
@@ -0,0 +1,299 @@
+#include "sweep.hpp"
+
+#include <cmath>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <cstdlib>
+#include <algorithm>
+
+#include "critical_section.hpp"
+
+namespace {
+
+// Options that make no sense for a single run of a sweep.
+const char* ignored_options[] = {
+  "headless", "seed", "trace-file", "record-file", "replay-file", "replay-seek",
+  "checkpoint-file", "checkpoint-at", "verify-checkpoint",
+  "compare-credit-policies"
+};
+
+/// Returns the name of the option in `arg`, e.g., "ticks" for "--ticks=10".
+std::string option_name(const std::string& arg) {
+  auto first = arg.find_first_not_of('-');
+  if (first == std::string::npos || first == 0)
+    return {};
+  auto result = arg.substr(first, arg.find('=') - first);
+  const std::string prefix = "global.";
+  if (result.compare(0, prefix.size(), prefix) == 0)
+    result.erase(0, prefix.size());
+  return result;
+}
+
+std::vector<std::string> split(const std::string& str, char delim) {
+  std::vector<std::string> result;
+  size_t first = 0;
+  for (;;) {
+    auto last = str.find(delim, first);
+    result.emplace_back(str.substr(first, last - first));
+    if (last == std::string::npos)
+      return result;
+    first = last + 1;
+  }
+}
+
+/// Returns the 97.5% quantile of Student's t-distribution.
+double t_quantile(size_t degrees_of_freedom) {
+  static constexpr double table[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+  };
+  if (degrees_of_freedom == 0)
+    return 0.;
+  if (degrees_of_freedom <= sizeof(table) / sizeof(double))
+    return table[degrees_of_freedom - 1];
+  return 1.96;
+}
+
+template <class F>
+sweep::estimate estimate_of(const std::vector<environment::run_summary>& xs,
+                            F f) {
+  sweep::estimate result;
+  if (xs.empty())
+    return result;
+  for (auto& x : xs)
+    result.mean += f(x);
+  result.mean /= xs.size();
+  if (xs.size() < 2)
+    return result;
+  double sq = 0;
+  for (auto& x : xs)
+    sq += (f(x) - result.mean) * (f(x) - result.mean);
+  result.stddev = std::sqrt(sq / (xs.size() - 1));
+  result.ci95 = t_quantile(xs.size() - 1) * result.stddev
+                / std::sqrt(static_cast<double>(xs.size()));
+  return result;
+}
+
+const char* metric_names[] = {
+  "throughput", "avg_latency", "p50", "p99", "p999", "idle",
+  "credit_oscillation"
+};
+
+std::vector<const sweep::estimate*> metrics_of(const sweep::row& x) {
+  return {&x.throughput, &x.avg_latency, &x.p50, &x.p99, &x.p999, &x.idle,
+          &x.credit_oscillation};
+}
+
+void write_json_value(FILE* f, const std::string& x) {
+  // JSON has no representation for nan or inf, which strtod accepts.
+  char* end = nullptr;
+  auto value = strtod(x.c_str(), &end);
+  if (!x.empty() && *end == '\0' && std::isfinite(value)) {
+    fputs(x.c_str(), f);
+    return;
+  }
+  fputc('"', f);
+  for (auto c : x) {
+    if (c == '"' || c == '\\')
+      fputc('\\', f);
+    fputc(c, f);
+  }
+  fputc('"', f);
+}
+
+} // namespace <anonymous>
+
+sweep::sweep(const std::vector<std::string>& args, std::vector<axis> grid,
+             int seeds, int threads)
+    : grid_(std::move(grid)),
+      seeds_(std::max(seeds, 1)),
+      threads_(threads) {
+  if (threads_ <= 0)
+    threads_ = std::max(static_cast<int>(std::thread::hardware_concurrency()),
+                        1);
+  for (size_t i = 0; i < args.size(); ++i) {
+    if (i > 0) {
+      auto name = option_name(args[i]);
+      if (name.compare(0, 5, "sweep") == 0
+          || std::find(std::begin(ignored_options), std::end(ignored_options),
+                       name) != std::end(ignored_options)
+          || std::any_of(grid_.begin(), grid_.end(),
+                         [&](const axis& x) { return x.name == name; }))
+        continue;
+    }
+    base_args_.emplace_back(args[i]);
+  }
+  base_args_.emplace_back("--headless");
+}
+
+bool sweep::parse_grid(const std::string& str, std::vector<axis>& result,
+                       std::string& err) {
+  result.clear();
+  for (auto& entry : split(str, ';')) {
+    if (entry.empty())
+      continue;
+    auto eq = entry.find('=');
+    if (eq == std::string::npos || eq == 0) {
+      err = "expected <name>=<values> in \"" + entry + "\"";
+      return false;
+    }
+    axis x;
+    x.name = entry.substr(0, eq);
+    for (auto& value : split(entry.substr(eq + 1), ','))
+      if (!value.empty())
+        x.values.emplace_back(std::move(value));
+    if (x.values.empty()) {
+      err = "no values for \"" + x.name + "\"";
+      return false;
+    }
+    result.emplace_back(std::move(x));
+  }
+  if (result.empty()) {
+    err = "empty grid";
+    return false;
+  }
+  return true;
+}
+
+void sweep::run() {
+  auto points = num_points();
+  auto num_runs = points * static_cast<size_t>(seeds_);
+  std::vector<environment::run_summary> results(num_runs);
+  std::vector<char> succeeded(num_runs, 0);
+  std::atomic<size_t> next{0};
+  std::atomic<size_t> done{0};
+  std::mutex stderr_mtx;
+  // Each worker picks the next run until none is left. Runs share nothing,
+  // i.e., workers only synchronize on `next` and for printing progress.
+  auto worker = [&] {
+    for (auto i = next++; i < num_runs; i = next++) {
+      auto args = args_for(i / seeds_, static_cast<int>(i % seeds_) + 1);
+      std::vector<char*> argv;
+      for (auto& arg : args)
+        argv.emplace_back(const_cast<char*>(arg.c_str()));
+      argv.emplace_back(nullptr);
+      QString err;
+      { // lifetime scope of env
+        environment env{static_cast<int>(args.size()), argv.data()};
+        err = env.simulate(results[i], false);
+      }
+      succeeded[i] = err.isEmpty() ? 1 : 0;
+      critical_section(stderr_mtx, [&] {
+        fprintf(stderr, "[%d/%d] run %d finished", static_cast<int>(++done),
+                static_cast<int>(num_runs), static_cast<int>(i));
+        if (!err.isEmpty())
+          fprintf(stderr, " with error: %s", err.toUtf8().constData());
+        fputc('\n', stderr);
+      });
+    }
+  };
+  std::vector<std::thread> workers;
+  auto n = std::min(static_cast<size_t>(threads_), num_runs);
+  for (size_t i = 0; i < n; ++i)
+    workers.emplace_back(worker);
+  for (auto& t : workers)
+    t.join();
+  // Aggregate results per point.
+  rows_.clear();
+  std::vector<environment::run_summary> xs;
+  for (size_t p = 0; p < points; ++p) {
+    row r;
+    auto k = p;
+    r.params.resize(grid_.size());
+    for (auto i = grid_.size(); i > 0; --i) {
+      auto& values = grid_[i - 1].values;
+      r.params[i - 1] = values[k % values.size()];
+      k /= values.size();
+    }
+    xs.clear();
+    for (size_t s = 0; s < static_cast<size_t>(seeds_); ++s)
+      if (succeeded[p * seeds_ + s])
+        xs.emplace_back(results[p * seeds_ + s]);
+    using summary = environment::run_summary;
+    r.runs = xs.size();
+    r.throughput = estimate_of(xs, [](const summary& x) {
+      return x.throughput;
+    });
+    r.avg_latency = estimate_of(xs, [](const summary& x) {
+      return x.avg_latency;
+    });
+    r.p50 = estimate_of(xs, [](const summary& x) { return x.p50; });
+    r.p99 = estimate_of(xs, [](const summary& x) { return x.p99; });
+    r.p999 = estimate_of(xs, [](const summary& x) { return x.p999; });
+    r.idle = estimate_of(xs, [](const summary& x) { return x.idle; });
+    r.credit_oscillation = estimate_of(xs, [](const summary& x) {
+      return x.credit_oscillation;
+    });
+    rows_.emplace_back(std::move(r));
+  }
+}
+
+bool sweep::write_report(const std::string& path) const {
+  auto f = fopen(path.c_str(), "w");
+  if (f == nullptr)
+    return false;
+  const std::string json = ".json";
+  if (path.size() >= json.size()
+      && path.compare(path.size() - json.size(), json.size(), json) == 0)
+    write_json(f);
+  else
+    write_csv(f);
+  fclose(f);
+  return true;
+}
+
+std::vector<std::string> sweep::args_for(size_t point, int seed) const {
+  auto result = base_args_;
+  for (auto i = grid_.size(); i > 0; --i) {
+    auto& x = grid_[i - 1];
+    result.emplace_back("--" + x.name + "=" + x.values[point % x.values.size()]);
+    point /= x.values.size();
+  }
+  result.emplace_back("--seed=" + std::to_string(seed));
+  return result;
+}
+
+size_t sweep::num_points() const {
+  size_t result = 1;
+  for (auto& x : grid_)
+    result *= x.values.size();
+  return result;
+}
+
+void sweep::write_csv(FILE* f) const {
+  for (auto& x : grid_)
+    fprintf(f, "%s,", x.name.c_str());
+  fputs("runs", f);
+  for (auto name : metric_names)
+    fprintf(f, ",%s_mean,%s_stddev,%s_ci95", name, name, name);
+  fputc('\n', f);
+  for (auto& r : rows_) {
+    for (auto& x : r.params)
+      fprintf(f, "%s,", x.c_str());
+    fprintf(f, "%d", static_cast<int>(r.runs));
+    for (auto x : metrics_of(r))
+      fprintf(f, ",%g,%g,%g", x->mean, x->stddev, x->ci95);
+    fputc('\n', f);
+  }
+}
+
+void sweep::write_json(FILE* f) const {
+  fputs("[\n", f);
+  for (size_t i = 0; i < rows_.size(); ++i) {
+    auto& r = rows_[i];
+    fputs("  {\"params\": {", f);
+    for (size_t j = 0; j < grid_.size(); ++j) {
+      fprintf(f, "%s\"%s\": ", j > 0 ? ", " : "", grid_[j].name.c_str());
+      write_json_value(f, r.params[j]);
+    }
+    fprintf(f, "}, \"runs\": %d", static_cast<int>(r.runs));
+    auto xs = metrics_of(r);
+    for (size_t j = 0; j < xs.size(); ++j)
+      fprintf(f, ", \"%s\": {\"mean\": %g, \"stddev\": %g, \"ci95\": %g}",
+              metric_names[j], xs[j]->mean, xs[j]->stddev, xs[j]->ci95);
+    fputs(i + 1 < rows_.size() ? "},\n" : "}\n", f);
+  }
+  fputs("]\n", f);
+}
@@ -1,10 +1,16 @@
 #include "term_gatherer.hpp"
 
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
 #include "caf/all.hpp"
 
 #include "entity.hpp"
+#include "checkpoint.hpp"
 #include "environment.hpp"
 #include "scatterer.hpp"
+#include "trace.hpp"
 
 using namespace caf;
 
@@ -12,36 +18,163 @@ term_gatherer::~term_gatherer() {
   // nop
 }
 
+void term_gatherer::init() {
+  auto& cfg = parent_->env()->cfg();
+  cycle_duration = cfg.cycle_duration;
+  min_tokens_ = cfg.min_tokens;
+  desired_batch_complexity_ = cfg.desired_batch_complexity;
+  target_queueing_delay_ = cfg.target_queueing_delay;
+  min_batch_size = cfg.min_batch_size;
+  max_min_fairness_ = cfg.max_min_fairness;
+  last_token_count_ = min_tokens_;
+  credit_policy_params params;
+  params.min_tokens = min_tokens_;
+  params.target_delay = target_queueing_delay_;
+  params.proportional = proportional_;
+  params.integral = integral_;
+  params.derivative = derivative_;
+  params.increase = min_batch_size;
+  // The environment validates all names when loading the layout.
+  policy_ = make_credit_policy(parent_->env()->credit_policy_of(parent_),
+                               params);
+  if (policy_ == nullptr)
+    policy_ = make_credit_policy("cycle", params);
+  if (cfg.latency_target > 0)
+    tuner_ = std::make_unique<batch_tuner>(cfg.latency_target, min_batch_size,
+                                           cycle_duration);
+}
+
+void term_gatherer::save_state(state_writer& out) const {
+  out.put(cycle_duration);
+  out.put(min_tokens_);
+  out.put(desired_batch_complexity_);
+  out.put(target_queueing_delay_);
+  out.put(min_batch_size);
+  out.put(batch_size_hint);
+  out.put(last_cycle_);
+  out.put(last_token_count_);
+  out.put(historic_time_per_item_);
+  out.put(processing_time_);
+  out.put(processed_items_);
+  out.put(completed_batches_);
+  out.put(queueing_time_);
+  out.put(cycle_timeout);
+  out.put(max_min_fairness_);
+  out.put(shares_.size());
+  for (auto& x : shares_)
+    out.put(x.target);
+  out.put(std::string{policy_->name()});
+  policy_->save_state(out);
+  out.put(tuner_ != nullptr);
+  if (tuner_ != nullptr)
+    for (auto& x : shares_)
+      out.put(tuner_->batch_size(x.path));
+}
+
 void term_gatherer::assign_credit(long available) {
-  // TODO: use path weights
-  printf("assign %ld credit\n", available);
+  TRACE_INFO(trace_event::assign_credit, parent_->rank(),
+             parent_->env()->timestamp(), available);
   CAF_LOG_TRACE(CAF_ARG(available));
   if (assignment_vec_.empty())
     return;
-  auto credit_per_path = available / static_cast<long>(assignment_vec_.size());
-  for (auto& kvp : assignment_vec_)
-    if (credit_per_path > kvp.first->assigned_credit)
-      kvp.second = credit_per_path - kvp.first->assigned_credit;
+  sync_shares();
+  double total_weight = 0;
+  for (auto& x : shares_) {
+    x.weight = weight_of(x);
+    total_weight += x.weight;
+    // A path that has credit left did not use all of its last assignment.
+    // Its demand is what it used plus a minimal batch. Paths without credit
+    // and new paths are backlogged.
+    auto left = x.path->assigned_credit;
+    if (max_min_fairness_ && x.target > 0 && left > 0)
+      x.demand = std::max(x.target - left, 0l) + min_batch_size;
+    else
+      x.demand = std::numeric_limits<double>::infinity();
+  }
+  // Water-filling: satisfy paths in ascending order of demand per weight and
+  // split the remaining credit among the others by weight. Without max-min
+  // fairness, all demands are infinite and this is a weighted split.
+  order_.resize(shares_.size());
+  for (size_t i = 0; i < order_.size(); ++i)
+    order_[i] = i;
+  std::sort(order_.begin(), order_.end(), [&](size_t x, size_t y) {
+    return shares_[x].demand / shares_[x].weight
+           < shares_[y].demand / shares_[y].weight;
+  });
+  auto remaining = static_cast<double>(available);
+  for (auto i : order_) {
+    auto& x = shares_[i];
+    auto share = std::min(remaining * x.weight / total_weight, x.demand);
+    x.target = static_cast<long>(share);
+    remaining -= share;
+    total_weight -= x.weight;
+  }
+  for (size_t i = 0; i < shares_.size(); ++i) {
+    auto& kvp = assignment_vec_[i];
+    auto target = shares_[i].target;
+    if (target > kvp.first->assigned_credit)
+      kvp.second = target - kvp.first->assigned_credit;
     else
       kvp.second = 0;
+  }
   emit_credits();
 }
 
 long term_gatherer::initial_credit(long downstream_capacity, path_ptr x) {
-  // TODO: implement me
-  CAF_IGNORE_UNUSED(downstream_capacity);
-  CAF_IGNORE_UNUSED(x);
-  return min_tokens_;
+  // A joining path gets its weighted share of the tokens for the current
+  // cycle. The next call to `assign_credit` rebalances all paths.
+  sync_shares();
+  auto i = std::find_if(shares_.begin(), shares_.end(),
+                        [=](const path_share& y) { return y.path == x; });
+  auto weight = weight_of(i != shares_.end() ? *i : make_share(x));
+  auto total_weight = i != shares_.end() ? 0. : weight;
+  for (auto& y : shares_)
+    total_weight += weight_of(y);
+  auto share = lround(last_token_count_ * weight / total_weight);
+  // Grant at least a minimal batch. Otherwise, the stream stalls if the
+  // downstream capacity is still unknown.
+  auto result = std::max(std::min(downstream_capacity, share), min_batch_size);
+  if (i != shares_.end())
+    i->target = result;
+  return result;
 }
 
-void term_gatherer::batch_completed(long xs_size, tick_time,
+bool term_gatherer::remove_path(const stream_id& sid, const actor_addr& x,
+                                error reason, bool silent) {
+  // Drop the share and the tuner state before CAF destroys the path.
+  auto path = find(sid, x);
+  if (path != nullptr) {
+    auto i = std::find_if(shares_.begin(), shares_.end(),
+                          [=](const path_share& y) { return y.path == path; });
+    if (i != shares_.end())
+      shares_.erase(i);
+    if (tuner_ != nullptr)
+      tuner_->remove_path(path);
+  }
+  return super::remove_path(sid, x, std::move(reason), silent);
+}
+
+bool term_gatherer::contains(inbound_path* x) const {
+  return std::any_of(paths_.begin(), paths_.end(),
+                     [=](const path_uptr& y) { return y.get() == x; });
+}
+
+void term_gatherer::batch_completed(inbound_path* from, long xs_size,
+                                    tick_time enqueue_time,
                                     tick_time start_time, tick_time end_time) {
-  printf("batch completed; xs_size : %ld, started: %d, ended: %d\n", xs_size,
-         start_time, end_time);
+  TRACE_INFO(trace_event::batch_completed, parent_->rank(),
+             parent_->env()->timestamp(), xs_size, start_time, end_time);
   CAF_ASSERT(xs_size > 0);
   CAF_ASSERT(end_time >= start_time);
   processed_items_ += xs_size;
   processing_time_ += end_time - start_time;
+  queueing_time_ += std::max(start_time - enqueue_time, 0);
+  ++completed_batches_;
+  if (tuner_ != nullptr) {
+    sync_shares();
+    tuner_->record(from, xs_size, end_time - std::min(enqueue_time, start_time),
+                   end_time - start_time);
+  }
   // Trigger cycle timeout if necessary.
   if (end_time >= last_cycle_ + cycle_duration) {
     generate_tokens(parent_->env()->timestamp());
@@ -49,51 +182,129 @@ void term_gatherer::batch_completed(long xs_size, tick_time,
 }
 
 long term_gatherer::generate_tokens(tick_time now) {
-  printf("generate tokens, tstamp: %d\n", now);
-  printf(
-    "last token count: %f, processed items: %ld, last_cycle: %d, now: %d\n",
-    last_token_count_, processed_items_, last_cycle_, now);
+  TRACE_INFO(trace_event::generate_tokens, parent_->rank(), now,
+             last_token_count_, processed_items_, last_cycle_);
   long result;
-  // Stick to the last processed token count if no batch was processed during
-  // the last cycle.
-  if (processed_items_ == 0 || now <= last_cycle_ || last_cycle_ == 0) {
+  // Stick to the last token count during the first cycle.
+  if (now <= last_cycle_ || last_cycle_ == 0) {
     result = static_cast<long>(last_token_count_);
   } else {
-    auto time_per_item = processing_time_ / static_cast<double>(processed_items_);
-    printf("time per item: %f\n", time_per_item);
-    if (time_per_item == 0) {
-      result = static_cast<long>(last_token_count_);
-    } else {
-      // Theoretical maximum when processing batches nonstop.
-      auto upper_bound = cycle_duration / time_per_item;
-      auto hint = std::max(min_batch_size,
-                           lround(desired_batch_complexity_ / time_per_item));
-      if (hint != batch_size_hint) {
-        batch_size_hint = hint;
-        for (auto& x : paths_)
-          x->desired_batch_size = hint;
+    credit_cycle cycle;
+    cycle.duration = now - last_cycle_;
+    cycle.processed_items = processed_items_;
+    cycle.batches = completed_batches_;
+    cycle.queueing_time = queueing_time_;
+    if (tuner_ != nullptr) {
+      // The tuner picks batch sizes per path instead of a single hint.
+      sync_shares();
+      tuner_->end_cycle(now, cycle.duration);
+      cycle_duration = tuner_->cycle_duration();
+      for (auto& x : shares_)
+        x.path->desired_batch_size = tuner_->batch_size(x.path);
+    }
+    if (processed_items_ > 0) {
+      auto time_per_item = processing_time_
+                           / static_cast<double>(processed_items_);
+      TRACE_INFO(trace_event::time_per_item, parent_->rank(), now,
+                 time_per_item);
+      if (time_per_item > 0) {
+        // Theoretical maximum when processing batches nonstop.
+        auto upper_bound = cycle_duration / time_per_item;
+        auto hint = std::max(min_batch_size,
+                             lround(desired_batch_complexity_ / time_per_item));
+        if (tuner_ == nullptr && hint != batch_size_hint) {
+          batch_size_hint = hint;
+          for (auto& x : paths_)
+            x->desired_batch_size = hint;
+        }
+        TRACE_INFO(trace_event::upper_bound, parent_->rank(), now,
+                   upper_bound);
+        cycle.time_per_item = time_per_item;
+        cycle.capacity = upper_bound;
       }
-      printf("upper bound: %f\n", upper_bound);
-      result = static_cast<long>(std::max(upper_bound, min_tokens_));
     }
+    result = policy_->generate_tokens(cycle);
   }
   last_cycle_ = now;
   last_token_count_ = result;
+  parent_->env()->record_tokens(parent_, result);
   assign_credit(result);
   set_cycle_timeout();
   // reset measurement variables
   processing_time_ = 0;
   processed_items_ = 0;
+  completed_batches_ = 0;
+  queueing_time_ = 0;
   return result;
 }
 
+void term_gatherer::sync_shares() {
+  auto unchanged = [&] {
+    if (shares_.size() != assignment_vec_.size())
+      return false;
+    for (size_t i = 0; i < shares_.size(); ++i)
+      if (shares_[i].path != assignment_vec_[i].first)
+        return false;
+    return true;
+  };
+  if (unchanged())
+    return;
+  // Keep the state of remaining paths and look up the upstream entity only
+  // for new paths.
+  std::vector<path_share> xs;
+  xs.reserve(assignment_vec_.size());
+  for (auto& kvp : assignment_vec_) {
+    auto path = kvp.first;
+    auto i = std::find_if(shares_.begin(), shares_.end(),
+                          [&](const path_share& x) { return x.path == path; });
+    if (i != shares_.end()) {
+      xs.emplace_back(*i);
+      continue;
+    }
+    xs.emplace_back(make_share(path));
+    if (tuner_ != nullptr) {
+      auto upstream = xs.back().upstream;
+      tuner_->add_path(path,
+                       upstream != nullptr ? upstream->id().toStdString()
+                                           : std::string{"?"},
+                       batch_size_hint);
+    }
+  }
+  if (tuner_ != nullptr)
+    for (auto& x : shares_)
+      if (std::none_of(xs.begin(), xs.end(), [&](const path_share& y) {
+            return y.path == x.path;
+          }))
+        tuner_->remove_path(x.path);
+  shares_.swap(xs);
+}
+
+term_gatherer::path_share term_gatherer::make_share(inbound_path* x) const {
+  auto hdl = caf::actor_cast<caf::actor_addr>(x->hdl);
+  auto upstream = parent_->env()->entity_by_handle(hdl);
+  return path_share{x, upstream, 0, 1., 0.};
+}
+
+double term_gatherer::weight_of(const path_share& x) {
+  double result = x.upstream != nullptr
+                  ? std::max(x.upstream->params().source_weight, 1)
+                  : 1;
+  switch (x.path->prio) {
+    case stream_priority::low:
+      return result;
+    case stream_priority::high:
+      return result * 4;
+    default:
+      return result * 2;
+  }
+}
+
 void term_gatherer::set_cycle_timeout() {
   auto ptr = make_mailbox_element(nullptr, message_id::make(), {},
                                   tick_atom::value, ++cycle_timeout);
   auto env = parent_->env();
   auto sim = parent_->sim();
   sim->push_pending_message(ptr.get());
-  sim->update_model();
   env->post_f(cycle_duration, [=, me = std::move(ptr)](tick_time) mutable {
     sim->enqueue(std::move(me), nullptr);
   });
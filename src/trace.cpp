@@ -0,0 +1,139 @@
+#include "trace.hpp"
+
+#include <mutex>
+#include <array>
+#include <vector>
+#include <cstdio>
+#include <algorithm>
+
+std::atomic<bool> trace_active{false};
+
+namespace {
+
+constexpr size_t ring_size = 4096;
+
+static_assert((ring_size & (ring_size - 1)) == 0,
+              "ring_size must be a power of two");
+
+class trace_ring;
+
+/// Owns the trace file and knows all per-thread rings.
+struct trace_sink {
+  std::mutex mtx;
+  FILE* file = nullptr;
+  std::vector<trace_ring*> rings;
+};
+
+trace_sink& sink() {
+  static trace_sink instance;
+  return instance;
+}
+
+/// A single-producer ring buffer of trace records. Only the owning thread
+/// pushes to the ring, while any thread holding the sink mutex may drain it.
+class trace_ring {
+public:
+  trace_ring() : head_(0), tail_(0) {
+    auto& s = sink();
+    std::unique_lock<std::mutex> guard{s.mtx};
+    s.rings.emplace_back(this);
+  }
+
+  ~trace_ring() {
+    auto& s = sink();
+    std::unique_lock<std::mutex> guard{s.mtx};
+    drain(s.file);
+    s.rings.erase(std::remove(s.rings.begin(), s.rings.end(), this),
+                  s.rings.end());
+  }
+
+  void push(const trace_record& x) {
+    auto h = head_.load(std::memory_order_relaxed);
+    if (h - tail_.load(std::memory_order_acquire) == ring_size) {
+      auto& s = sink();
+      std::unique_lock<std::mutex> guard{s.mtx};
+      drain(s.file);
+    }
+    buf_[h & (ring_size - 1)] = x;
+    head_.store(h + 1, std::memory_order_release);
+  }
+
+  /// Writes all pending records to `f` or discards them if `f == nullptr`.
+  /// @pre The calling thread holds the sink mutex.
+  void drain(FILE* f) {
+    auto t = tail_.load(std::memory_order_relaxed);
+    auto h = head_.load(std::memory_order_acquire);
+    while (t != h) {
+      auto first = t & (ring_size - 1);
+      auto n = std::min(h - t, ring_size - first);
+      if (f != nullptr)
+        fwrite(&buf_[first], sizeof(trace_record), n, f);
+      t += n;
+    }
+    tail_.store(t, std::memory_order_release);
+  }
+
+private:
+  std::atomic<size_t> head_;
+  std::atomic<size_t> tail_;
+  std::array<trace_record, ring_size> buf_;
+};
+
+thread_local trace_ring ring;
+
+const char* trace_event_names[] = {
+  "entity_name",
+  "sink_idling",
+  "message_received",
+  "message_consumed",
+  "assign_credit",
+  "batch_completed",
+  "generate_tokens",
+  "time_per_item",
+  "upper_bound"
+};
+
+} // namespace <anonymous>
+
+const char* to_string(trace_event x) {
+  auto i = static_cast<size_t>(x);
+  if (i >= sizeof(trace_event_names) / sizeof(const char*))
+    return "<invalid>";
+  return trace_event_names[i];
+}
+
+bool trace_open(const std::string& path) {
+  trace_close();
+  auto& s = sink();
+  std::unique_lock<std::mutex> guard{s.mtx};
+  s.file = fopen(path.c_str(), "wb");
+  if (s.file == nullptr)
+    return false;
+  fwrite(trace_file_magic, 1, sizeof(trace_file_magic), s.file);
+  trace_active = true;
+  return true;
+}
+
+void trace_close() {
+  trace_active = false;
+  auto& s = sink();
+  std::unique_lock<std::mutex> guard{s.mtx};
+  if (s.file == nullptr)
+    return;
+  for (auto r : s.rings)
+    r->drain(s.file);
+  fclose(s.file);
+  s.file = nullptr;
+}
+
+void trace_push(const trace_record& x) {
+  ring.push(x);
+}
+
+void trace_name(int32_t entity, const std::string& name) {
+  if (!trace_enabled())
+    return;
+  trace_record x{trace_event::entity_name, 0, 0, entity, 0, {0, 0, 0}};
+  memcpy(x.args, name.data(), std::min(name.size(), sizeof(x.args)));
+  trace_push(x);
+}
@@ -19,10 +19,22 @@ SOURCES += \
     src/entity.cpp \
     src/entity_details.cpp \
     src/environment.cpp \
+    src/batch_tuner.cpp \
+    src/checkpoint.cpp \
+    src/credit_policy.cpp \
+    src/fiber.cpp \
     src/gatherer.cpp \
+    src/latency_stats.cpp \
+    src/layered_layout.cpp \
     src/main.cpp \
     src/mainwindow.cpp \
+    src/message_tracker.cpp \
+    src/replay_log.cpp \
+    src/sweep.cpp \
+    src/trace.cpp \
     src/node.cpp \
+    src/quadtree.cpp \
+    src/rate_meter.cpp \
     src/rate_controlled_sink.cpp \
     src/rate_controlled_source.cpp \
     src/simulant.cpp \
@@ -31,8 +43,7 @@ SOURCES += \
     src/sink.cpp \
     src/source.cpp \
     src/stage.cpp \
-    src/term_gatherer.cpp \
-    src/term_scatterer.cpp
+    src/term_gatherer.cpp
 
 HEADERS += \
     include/critical_section.hpp \
@@ -41,11 +52,24 @@ HEADERS += \
     include/entity.hpp \
     include/entity_details.hpp \
     include/environment.hpp \
+    include/batch_tuner.hpp \
+    include/checkpoint.hpp \
+    include/credit_policy.hpp \
+    include/fiber.hpp \
     include/fwd.hpp \
     include/gatherer.hpp \
+    include/latency_stats.hpp \
+    include/layered_layout.hpp \
     include/mainwindow.hpp \
+    include/message_tracker.hpp \
+    include/replay_log.hpp \
+    include/sweep.hpp \
+    include/trace.hpp \
+    include/varint.hpp \
     include/node.hpp \
     include/qstr.hpp \
+    include/quadtree.hpp \
+    include/rate_meter.hpp \
     include/rate_controlled_sink.hpp \
     include/rate_controlled_source.hpp \
     include/scatterer.hpp \
@@ -56,7 +80,8 @@ HEADERS += \
     include/source.hpp \
     include/stage.hpp \
     include/term_gatherer.hpp \
-    include/tick_time.hpp
+    include/tick_time.hpp \
+    include/timing_wheel.hpp
 
 FORMS += \
     ui/mainwindow.ui \
@@ -0,0 +1,14 @@
+TARGET = timing-wheel-bench
+TEMPLATE = app
+
+CONFIG += console c++14 release
+CONFIG -= qt app_bundle
+
+INCLUDEPATH += include/
+
+SOURCES += \
+    tools/timing_wheel_bench.cpp
+
+HEADERS += \
+    include/tick_time.hpp \
+    include/timing_wheel.hpp
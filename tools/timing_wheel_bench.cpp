@@ -0,0 +1,113 @@
+/// Compares timing_wheel against the map-based queues it replaced in the
+/// environment by pushing pending events and then draining them tick by tick.
+/// Usage: timing-wheel-bench [num-events] [max-delay]
+
+#include <map>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+#include "tick_time.hpp"
+#include "timing_wheel.hpp"
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+/// Stores timestamps and values of all events in insertion order.
+struct workload {
+  std::vector<tick_time> times;
+  std::vector<int> values;
+  tick_time last;
+};
+
+workload make_workload(size_t num_events, tick_duration max_delay) {
+  workload result;
+  result.times.reserve(num_events);
+  result.values.reserve(num_events);
+  result.last = 0;
+  std::mt19937 rng{42};
+  std::uniform_int_distribution<tick_duration> delay{1, max_delay};
+  for (size_t i = 0; i < num_events; ++i) {
+    auto t = delay(rng);
+    result.times.emplace_back(t);
+    result.values.emplace_back(static_cast<int>(i));
+    if (t > result.last)
+      result.last = t;
+  }
+  return result;
+}
+
+/// Runs `f` and prints its runtime in milliseconds along with the checksum
+/// that keeps the compiler from dropping the work.
+template <class F>
+void measure(const char* name, F f) {
+  auto start = clock_type::now();
+  auto checksum = f();
+  auto end = clock_type::now();
+  auto ms = std::chrono::duration<double, std::milli>(end - start).count();
+  printf("%-28s %10.1f ms (checksum %lld)\n", name, ms,
+         static_cast<long long>(checksum));
+}
+
+int64_t run_wheel(const workload& w) {
+  timing_wheel<int> q;
+  for (size_t i = 0; i < w.times.size(); ++i)
+    q.push(w.times[i], w.values[i]);
+  int64_t checksum = 0;
+  for (tick_time t = 0; t <= w.last; ++t)
+    q.drain(t, [&](tick_time, int x) { checksum += x; });
+  return checksum;
+}
+
+int64_t run_map(const workload& w) {
+  std::map<tick_time, std::vector<int>> q;
+  for (size_t i = 0; i < w.times.size(); ++i)
+    q[w.times[i]].emplace_back(w.values[i]);
+  int64_t checksum = 0;
+  for (tick_time t = 0; t <= w.last; ++t) {
+    auto i = q.find(t);
+    if (i == q.end())
+      continue;
+    for (auto x : i->second)
+      checksum += x;
+    q.erase(i);
+  }
+  return checksum;
+}
+
+int64_t run_multimap(const workload& w) {
+  std::multimap<tick_time, int> q;
+  for (size_t i = 0; i < w.times.size(); ++i)
+    q.emplace(w.times[i], w.values[i]);
+  int64_t checksum = 0;
+  for (tick_time t = 0; t <= w.last; ++t) {
+    auto first = q.begin();
+    auto last = q.upper_bound(t);
+    for (auto i = first; i != last; ++i)
+      checksum += i->second;
+    q.erase(first, last);
+  }
+  return checksum;
+}
+
+} // namespace <anonymous>
+
+int main(int argc, char** argv) {
+  size_t num_events = argc > 1 ? std::stoul(argv[1]) : 1000000;
+  tick_duration max_delay = argc > 2 ? std::stoi(argv[2]) : 1000;
+  if (num_events == 0 || max_delay < 1) {
+    fprintf(stderr, "usage: %s [num-events] [max-delay]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  printf("%zu pending events, delays of 1-%d ticks\n", num_events,
+         max_delay);
+  auto w = make_workload(num_events, max_delay);
+  measure("timing_wheel", [&] { return run_wheel(w); });
+  measure("map<tick_time, vector>", [&] { return run_map(w); });
+  measure("multimap<tick_time, T>", [&] { return run_multimap(w); });
+  return EXIT_SUCCESS;
+}
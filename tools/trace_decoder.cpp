@@ -0,0 +1,106 @@
+/// Decodes binary trace files written by the stream simulator into text.
+/// Usage: trace-decoder <trace-file>
+
+#include <map>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <cinttypes>
+
+#include "trace.hpp"
+
+namespace {
+
+std::map<int32_t, std::string> names;
+
+void add_name(const trace_record& x) {
+  char buf[sizeof(x.args) + 1];
+  memcpy(buf, x.args, sizeof(x.args));
+  buf[sizeof(x.args)] = '\0';
+  names[x.entity] = buf;
+}
+
+const char* name_of(int32_t entity) {
+  auto i = names.find(entity);
+  return i != names.end() ? i->second.c_str() : "<unknown>";
+}
+
+void print(const trace_record& x) {
+  auto& a = x.args;
+  printf("[t %d] ", x.time);
+  switch (x.event) {
+    case trace_event::entity_name:
+      printf("entity %d is %s\n", x.entity, name_of(x.entity));
+      break;
+    case trace_event::sink_idling:
+      printf("%s idling for %" PRId64 " ticks\n", name_of(x.entity),
+             trace_int(a[0]));
+      break;
+    case trace_event::message_received:
+      printf("%s received msg #%" PRId64 " (type token %" PRIx64 ")\n",
+             name_of(x.entity), trace_int(a[0]), a[1]);
+      break;
+    case trace_event::message_consumed:
+      printf("%s consumed msg #%" PRId64 "\n", name_of(x.entity),
+             trace_int(a[0]));
+      break;
+    case trace_event::assign_credit:
+      printf("%s assign %" PRId64 " credit\n", name_of(x.entity),
+             trace_int(a[0]));
+      break;
+    case trace_event::batch_completed:
+      printf("%s batch completed; xs_size: %" PRId64 ", started: %" PRId64
+             ", ended: %" PRId64 "\n",
+             name_of(x.entity), trace_int(a[0]), trace_int(a[1]),
+             trace_int(a[2]));
+      break;
+    case trace_event::generate_tokens:
+      printf("%s generate tokens; last token count: %f, processed items: "
+             "%" PRId64 ", last cycle: %" PRId64 "\n",
+             name_of(x.entity), trace_double(a[0]), trace_int(a[1]),
+             trace_int(a[2]));
+      break;
+    case trace_event::time_per_item:
+      printf("%s time per item: %f\n", name_of(x.entity), trace_double(a[0]));
+      break;
+    case trace_event::upper_bound:
+      printf("%s upper bound: %f\n", name_of(x.entity), trace_double(a[0]));
+      break;
+    default:
+      printf("%s %s %" PRIx64 " %" PRIx64 " %" PRIx64 "\n", name_of(x.entity),
+             to_string(x.event), a[0], a[1], a[2]);
+  }
+}
+
+} // namespace <anonymous>
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s <trace-file>\n", argv[0]);
+    return 1;
+  }
+  auto f = fopen(argv[1], "rb");
+  if (f == nullptr) {
+    fprintf(stderr, "cannot open %s\n", argv[1]);
+    return 1;
+  }
+  char magic[sizeof(trace_file_magic)];
+  if (fread(magic, 1, sizeof(magic), f) != sizeof(magic)
+      || memcmp(magic, trace_file_magic, sizeof(magic)) != 0) {
+    fprintf(stderr, "%s is not a trace file\n", argv[1]);
+    fclose(f);
+    return 1;
+  }
+  // Records from different threads may appear out of order, so we collect
+  // all entity names before printing.
+  auto first_record = ftell(f);
+  trace_record x;
+  while (fread(&x, sizeof(x), 1, f) == 1)
+    if (x.event == trace_event::entity_name)
+      add_name(x);
+  fseek(f, first_record, SEEK_SET);
+  while (fread(&x, sizeof(x), 1, f) == 1)
+    print(x);
+  fclose(f);
+  return 0;
+}
@@ -0,0 +1,15 @@
+TARGET = trace-decoder
+TEMPLATE = app
+
+CONFIG += console c++14
+CONFIG -= qt app_bundle
+
+INCLUDEPATH += include/
+
+SOURCES += \
+    src/trace.cpp \
+    tools/trace_decoder.cpp
+
+HEADERS += \
+    include/tick_time.hpp \
+    include/trace.hpp